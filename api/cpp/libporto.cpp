@@ -74,6 +74,45 @@ exit:
     return LastError;
 }
 
+int TPortoAPI::PipelineSend(rpc::TContainerRequest &req, uint64_t &id) {
+    LastErrorMsg = "";
+    LastError = (int)EError::Unknown;
+
+    if (Fd < 0) {
+        TError error = ConnectToRpcServer(RpcSocketPath, Fd);
+        if (error) {
+            LastErrorMsg = error.GetMsg();
+            LastError = INT_MAX;
+            return LastError;
+        }
+    }
+
+    id = ++LastRequestId;
+    req.set_id(id);
+
+    google::protobuf::io::FileOutputStream post(Fd);
+    if (!WriteDelimitedTo(req, &post) || !post.Flush()) {
+        Cleanup();
+        return -1;
+    }
+
+    LastError = (int)EError::Success;
+    return LastError;
+}
+
+int TPortoAPI::PipelineRecv(rpc::TContainerResponse &rsp, uint64_t &id) {
+    rsp.Clear();
+
+    int ret = Recv(rsp);
+    if (ret < 0) {
+        Cleanup();
+        return ret;
+    }
+
+    id = rsp.id();
+    return ret;
+}
+
 int TPortoAPI::Raw(const std::string &message, string &responce) {
     if (!google::protobuf::TextFormat::ParseFromString(message, &Req) ||
         !Req.IsInitialized())
@@ -86,6 +125,26 @@ int TPortoAPI::Raw(const std::string &message, string &responce) {
     return ret;
 }
 
+int TPortoAPI::Batch(const std::vector<rpc::TContainerRequest> &requests,
+                     std::vector<rpc::TContainerResponse> &responses,
+                     bool stopOnError) {
+    auto batch = Req.mutable_batch();
+
+    for (auto &r : requests)
+        *batch->add_request() = r;
+    if (stopOnError)
+        batch->set_stop_on_error(true);
+
+    int ret = Rpc(Req, Rsp);
+    if (!ret) {
+        responses.clear();
+        for (auto &r : Rsp.batch().response())
+            responses.push_back(r);
+    }
+
+    return ret;
+}
+
 int TPortoAPI::Create(const string &name) {
     Req.mutable_create()->set_name(name);
 
@@ -110,6 +169,31 @@ int TPortoAPI::List(vector<string> &clist) {
     return ret;
 }
 
+int TPortoAPI::List(vector<string> &clist, const string &mask,
+                    const string &state, const string &cursor,
+                    uint32_t limit, string *nextCursor) {
+    auto req = Req.mutable_list();
+
+    if (mask != "")
+        req->set_mask(mask);
+    if (state != "")
+        req->set_state(state);
+    if (cursor != "")
+        req->set_cursor(cursor);
+    if (limit)
+        req->set_limit(limit);
+
+    int ret = Rpc(Req, Rsp);
+    if (!ret) {
+        for (int i = 0; i < Rsp.list().name_size(); i++)
+            clist.push_back(Rsp.list().name(i));
+        if (nextCursor)
+            *nextCursor = Rsp.list().next_cursor();
+    }
+
+    return ret;
+}
+
 int TPortoAPI::Plist(vector<TProperty> &plist) {
     Req.mutable_propertylist();
 
@@ -142,9 +226,13 @@ int TPortoAPI::Dlist(vector<TData> &dlist) {
 
 int TPortoAPI::Get(const std::vector<std::string> &name,
                    const std::vector<std::string> &variable,
-                   std::map<std::string, std::map<std::string, TPortoGetResponse>> &result) {
+                   std::map<std::string, std::map<std::string, TPortoGetResponse>> &result,
+                   uint64_t maxStalenessMs) {
     auto get = Req.mutable_get();
 
+    if (maxStalenessMs)
+        get->set_max_staleness_ms(maxStalenessMs);
+
     for (auto n : name)
         get->add_name(n);
     for (auto v : variable)
@@ -195,9 +283,12 @@ int TPortoAPI::SetProperty(const string &name, const string &property, string va
     return Rpc(Req, Rsp);
 }
 
-int TPortoAPI::GetData(const string &name, const string &data, string &value) {
+int TPortoAPI::GetData(const string &name, const string &data, string &value,
+                       uint64_t maxStalenessMs) {
     Req.mutable_getdata()->set_name(name);
     Req.mutable_getdata()->set_data(data);
+    if (maxStalenessMs)
+        Req.mutable_getdata()->set_max_staleness_ms(maxStalenessMs);
 
     int ret = Rpc(Req, Rsp);
     if (!ret)
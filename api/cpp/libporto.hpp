@@ -46,6 +46,7 @@ class TPortoAPI {
     rpc::TContainerResponse Rsp;
     int LastError;
     std::string LastErrorMsg;
+    uint64_t LastRequestId = 0;
 
     int Recv(rpc::TContainerResponse &rsp);
     int SendReceive(rpc::TContainerRequest &req, rpc::TContainerResponse &rsp);
@@ -66,19 +67,31 @@ public:
     int Wait(const std::vector<std::string> &containers, std::string &name, int timeout = -1);
 
     int List(std::vector<std::string> &clist);
+    // names matching glob mask and state, at most limit of them after cursor,
+    // nextCursor is empty if there is nothing more
+    int List(std::vector<std::string> &clist, const std::string &mask,
+             const std::string &state = "", const std::string &cursor = "",
+             uint32_t limit = 0, std::string *nextCursor = nullptr);
     int Plist(std::vector<TProperty> &plist);
     int Dlist(std::vector<TData> &dlist);
 
     int Get(const std::vector<std::string> &name,
             const std::vector<std::string> &variable,
-            std::map<std::string, std::map<std::string, TPortoGetResponse>> &result);
+            std::map<std::string, std::map<std::string, TPortoGetResponse>> &result,
+            uint64_t maxStalenessMs = 0);
 
     int GetProperty(const std::string &name, const std::string &property, std::string &value);
     int SetProperty(const std::string &name, const std::string &property, std::string value);
 
-    int GetData(const std::string &name, const std::string &data, std::string &value);
+    int GetData(const std::string &name, const std::string &data, std::string &value,
+                uint64_t maxStalenessMs = 0);
     int GetVersion(std::string &tag, std::string &revision);
 
+    // executes all requests at once, results are stored in response
+    int Batch(const std::vector<rpc::TContainerRequest> &requests,
+              std::vector<rpc::TContainerResponse> &responses,
+              bool stopOnError = false);
+
     int Raw(const std::string &message, std::string &response);
     void GetLastError(int &error, std::string &msg) const;
     void Cleanup();
@@ -104,4 +117,9 @@ public:
     int ListLayers(std::vector<std::string> &layers);
 
     void Send(rpc::TContainerRequest &req);
+
+    // Pipelined mode: send several requests without waiting for replies,
+    // then receive responses in any order and match them by request id.
+    int PipelineSend(rpc::TContainerRequest &req, uint64_t &id);
+    int PipelineRecv(rpc::TContainerResponse &rsp, uint64_t &id);
 };
@@ -131,9 +131,13 @@ class _RPC(object):
 
         return resp
 
-    def List(self):
+    def List(self, mask=None, state=None):
         request = rpc_pb2.TContainerRequest()
         request.list.CopyFrom(rpc_pb2.TContainerListRequest())
+        if mask is not None:
+            request.list.mask = mask
+        if state is not None:
+            request.list.state = state
         return self.call(request, self.timeout).list.name
 
     def Create(self, name):
@@ -199,10 +203,12 @@ class _RPC(object):
         request.setProperty.value = value
         self.call(request, self.timeout)
 
-    def GetData(self, name, data):
+    def GetData(self, name, data, max_staleness_ms=None):
         request = rpc_pb2.TContainerRequest()
         request.getData.name = name
         request.getData.data = data
+        if max_staleness_ms:
+            request.getData.max_staleness_ms = max_staleness_ms
         res = self.call(request, self.timeout).getData.value
         if res == 'false':
             return False
@@ -210,10 +216,12 @@ class _RPC(object):
             return True
         return res
 
-    def Get(self, name, var):
+    def Get(self, name, var, max_staleness_ms=None):
         request = rpc_pb2.TContainerRequest()
         request.get.name.extend(name)
         request.get.variable.extend(var)
+        if max_staleness_ms:
+            request.get.max_staleness_ms = max_staleness_ms
         resp = self.call(request, self.timeout)
         if resp.error != rpc_pb2.Success:
             raise exceptions.EError.Create(resp.error, resp.errorMsg)
@@ -316,8 +324,8 @@ class Connection(object):
     def _rpc(self, request):
         return self.rpc.call(request)
 
-    def List(self):
-        return self.rpc.List()
+    def List(self, mask=None, state=None):
+        return self.rpc.List(mask, state)
 
     def Find(self, name):
         if name not in self.List():
@@ -350,8 +358,8 @@ class Connection(object):
     def Resume(self, name):
         self.rpc.Resume(name)
 
-    def Get(self, name, var):
-        return self.rpc.Get(name, var)
+    def Get(self, name, var, max_staleness_ms=None):
+        return self.rpc.Get(name, var, max_staleness_ms)
 
     def GetProperty(self, name, property):
         return self.rpc.GetProperty(name, property)
@@ -359,8 +367,8 @@ class Connection(object):
     def SetProperty(self, name, property, value):
         self.rpc.SetProperty(name, property, value)
 
-    def GetData(self, name, data):
-        return self.rpc.GetData(name, data)
+    def GetData(self, name, data, max_staleness_ms=None):
+        return self.rpc.GetData(name, data, max_staleness_ms)
 
     def Plist(self):
         return self.rpc.Plist()
@@ -2,9 +2,13 @@
 #include <sstream>
 #include <algorithm>
 #include <csignal>
+#include <list>
+#include <map>
+#include <mutex>
 
 #include "cgroup.hpp"
 #include "config.hpp"
+#include "statistics.hpp"
 #include "subsystem.hpp"
 #include "task.hpp"
 #include "util/log.hpp"
@@ -13,12 +17,78 @@
 #include "util/mount.hpp"
 #include "util/folder.hpp"
 
+extern "C" {
+#include <fcntl.h>
+#include <unistd.h>
+}
+
 using std::string;
 using std::vector;
 using std::shared_ptr;
 using std::weak_ptr;
 using std::set;
 
+// Knobs which are read much more often than written: keep them open
+// and re-read with pread() from offset zero.
+static const char *HotKnobs[] = {
+    "cpuacct.usage",
+    "memory.usage_in_bytes",
+    "freezer.state",
+    "blkio.io_service_bytes_recursive",
+};
+
+// LRU of open hot knobs, limited by daemon.max_knob_fds
+class TKnobFdCache : public TNonCopyable {
+    typedef std::pair<const TCgroup *, int> TKey;
+    typedef std::pair<TKey, std::shared_ptr<TScopedFd>> TEntry;
+
+    std::mutex Lock;
+    std::list<TEntry> Lru;
+    std::map<TKey, std::list<TEntry>::iterator> Index;
+
+public:
+    std::shared_ptr<TScopedFd> Get(const TCgroup *cg, int knob) {
+        std::lock_guard<std::mutex> lock(Lock);
+        auto it = Index.find(TKey(cg, knob));
+        if (it == Index.end())
+            return nullptr;
+        Lru.splice(Lru.begin(), Lru, it->second);
+        return it->second->second;
+    }
+
+    void Put(const TCgroup *cg, int knob, std::shared_ptr<TScopedFd> fd) {
+        std::lock_guard<std::mutex> lock(Lock);
+        TKey key(cg, knob);
+        if (Index.count(key))
+            return;
+
+        size_t max = config().daemon().max_knob_fds();
+        while (Lru.size() && Lru.size() >= max) {
+            Index.erase(Lru.back().first);
+            Lru.pop_back();
+        }
+        if (!max)
+            return;
+
+        Lru.emplace_front(key, fd);
+        Index[key] = Lru.begin();
+        Statistics->KnobFds = Lru.size();
+    }
+
+    // descriptors still in use by readers are closed by the last of them
+    void Release(const TCgroup *cg) {
+        std::lock_guard<std::mutex> lock(Lock);
+        auto it = Index.lower_bound(TKey(cg, 0));
+        while (it != Index.end() && it->first.first == cg) {
+            Lru.erase(it->second);
+            it = Index.erase(it);
+        }
+        Statistics->KnobFds = Lru.size();
+    }
+};
+
+static TKnobFdCache KnobFdCache;
+
 // TCgroup
 TCgroup::TCgroup(const vector<shared_ptr<TSubsystem>> subsystems,
                  const std::shared_ptr<TMount> m) :
@@ -41,17 +111,20 @@ TCgroup::~TCgroup() {
     TError error = Remove();
     if (error)
         L_ERR() << "Can't remove cgroup directory: " << error << std::endl;
+    ReleaseKnobs();
 }
 
 shared_ptr<TCgroup> TCgroup::GetChild(const std::string& name) {
+    std::lock_guard<std::mutex> lock(ChildrenLock);
+
     for (auto iter = Children.begin(); iter != Children.end();) {
-        if (auto child = iter->lock()) {
-            if (child->Name == name)
-                return child;
-        } else {
+        auto child = iter->lock();
+        if (!child) {
             iter = Children.erase(iter);
             continue;
         }
+        if (child->Name == name)
+            return child;
         iter++;
     }
 
@@ -181,12 +254,19 @@ TError TCgroup::Remove() {
     // at this point we should have gracefully terminated all tasks
     // in the container; if anything is still alive we have no other choice
     // but to kill it with SIGKILL
-    int ret = RetryFailed(config().daemon().cgroup_remove_timeout_s() * 10, 100,
-                          [&]{ Kill(SIGKILL);
-                               return !IsEmpty(); });
+    if (!IsEmpty()) {
+        (void)KillAll(SIGKILL);
+
+        int ret = RetryBackoff(config().daemon().cgroup_remove_timeout_s() * 1000, 100,
+                               [&]{ if (IsEmpty())
+                                        return 0;
+                                    Kill(SIGKILL);
+                                    return 1; });
+        if (ret)
+            L_ERR() << "Can't kill all tasks in cgroup " << Path() << std::endl;
+    }
 
-    if (ret)
-        L_ERR() << "Can't kill all tasks in cgroup " << Path() << std::endl;
+    ReleaseKnobs();
 
     L_ACT() << "Remove cgroup " << Path() << std::endl;
     TFolder f(Path());
@@ -217,17 +297,142 @@ TError TCgroup::Kill(int signal) const {
     return TError::Success();
 }
 
+TError TCgroup::KillAll(int signal, TScopedLock *lock) const {
+    if (IsRoot())
+        return TError::Success();
+
+    std::string state;
+    if (!HasKnob("freezer.state") || GetKnobValue("freezer.state", state) ||
+            StringTrim(state) != "THAWED")
+        return Kill(signal);
+
+    TError error = SetKnobValue("freezer.state", "FROZEN");
+    if (!error) {
+        std::unique_ptr<TScopedUnlock> unlock;
+        if (lock)
+            unlock.reset(new TScopedUnlock(*lock));
+
+        if (RetryBackoff(config().daemon().freezer_wait_timeout_s() * 1000, 100, [&]{
+                    return GetKnobValue("freezer.state", state) ||
+                           StringTrim(state) != "FROZEN"; }))
+            error = TError(EError::Unknown, "Can't freeze cgroup " + Path().ToString());
+    }
+
+    // pid list of frozen cgroup is stable, signals are delivered on thaw
+    TError killError = Kill(signal);
+
+    if (error)
+        L_ERR() << "Can't kill cgroup " << Path() << " frozen: " << error << std::endl;
+
+    // thaw even if freezing didn't finish, otherwise tasks never get signal
+    error = SetKnobValue("freezer.state", "THAWED");
+    if (error)
+        L_ERR() << "Can't thaw cgroup " << Path() << ": " << error << std::endl;
+
+    return killError;
+}
+
+bool TCgroup::WaitEmpty(int timeoutMs) const {
+    return !RetryBackoff(timeoutMs, 100, [&]{ return !IsEmpty(); });
+}
+
 bool TCgroup::HasKnob(const std::string &knob) const {
     TFile f(Path() / knob);
     return f.Exists();
 }
 
+int TCgroup::HotKnob(const std::string &knob) const {
+    for (size_t i = 0; i < sizeof(HotKnobs) / sizeof(HotKnobs[0]); i++)
+        if (knob == HotKnobs[i])
+            return i;
+    return -1;
+}
+
+TError TCgroup::ReadHotKnob(int knob, char *buf, size_t size, size_t &len) const {
+    auto fd = KnobFdCache.Get(this, knob);
+    if (!fd) {
+        TPath path = Path() / HotKnobs[knob];
+        fd = std::make_shared<TScopedFd>(open(path.ToString().c_str(), O_RDONLY | O_CLOEXEC));
+        if (fd->GetFd() < 0)
+            return TError(EError::Unknown, errno, "open(" + path.ToString() + ")");
+        KnobFdCache.Put(this, knob, fd);
+    }
+
+    len = 0;
+    while (len < size) {
+        ssize_t ret = pread(fd->GetFd(), buf + len, size - len, len);
+        if (ret < 0)
+            return TError(EError::Unknown, errno, "pread(" + (Path() / HotKnobs[knob]).ToString() + ")");
+        if (ret == 0)
+            return TError::Success();
+        len += ret;
+    }
+
+    return TError(EError::Unknown, E2BIG, "Knob " + (Path() / HotKnobs[knob]).ToString() + " is too large");
+}
+
+void TCgroup::ReleaseKnobs() const {
+    KnobFdCache.Release(this);
+}
+
 TError TCgroup::GetKnobValue(const std::string &knob, std::string &value) const {
+    int hot = HotKnob(knob);
+    if (hot >= 0) {
+        char buf[4096];
+        size_t len;
+
+        TError error = ReadHotKnob(hot, buf, sizeof(buf), len);
+        if (!error)
+            value.assign(buf, len);
+        if (error.GetErrno() != E2BIG)
+            return error;
+    }
+
     TFile f(Path() / knob);
     return f.AsString(value);
 }
 
+TError TCgroup::GetKnobValue(const std::string &knob, uint64_t &value) const {
+    char buf[32];
+    size_t len;
+    TError error;
+
+    int hot = HotKnob(knob);
+    if (hot >= 0) {
+        error = ReadHotKnob(hot, buf, sizeof(buf) - 1, len);
+        if (error)
+            return error;
+        buf[len] = 0;
+    } else {
+        std::string str;
+        error = GetKnobValue(knob, str);
+        if (error)
+            return error;
+        return StringToUint64(StringTrim(str), value);
+    }
+
+    char *end;
+    errno = 0;
+    value = strtoull(buf, &end, 10);
+    if (errno || end == buf || (*end && *end != '\n'))
+        return TError(EError::Unknown, "Can't parse " + (Path() / knob).ToString() + ": " + buf);
+
+    return TError::Success();
+}
+
 TError TCgroup::GetKnobValueAsLines(const std::string &knob, vector<string> &lines) const {
+    if (HotKnob(knob) >= 0) {
+        std::string value;
+        TError error = GetKnobValue(knob, value);
+        if (error)
+            return error;
+
+        std::istringstream stream(value);
+        for (std::string line; std::getline(stream, line);)
+            lines.push_back(line);
+        return TError::Success();
+    }
+
     TFile f(Path() / knob);
     return f.AsLines(lines);
 }
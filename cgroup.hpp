@@ -5,6 +5,7 @@
 
 #include "common.hpp"
 #include "util/path.hpp"
+#include "util/locks.hpp"
 
 class TSubsystem;
 class TMount;
@@ -13,10 +14,16 @@ class TCgroup : public std::enable_shared_from_this<TCgroup>,
                 public TNonCopyable {
     const std::string Name;
     const std::shared_ptr<TCgroup> Parent;
+    // metrics sampler and lockless readers get children without holder lock
+    std::mutex ChildrenLock;
     std::vector<std::weak_ptr<TCgroup>> Children;
     std::shared_ptr<TMount> Mount;
     mode_t Mode = 0755;
 
+    int HotKnob(const std::string &knob) const;
+    TError ReadHotKnob(int knob, char *buf, size_t size, size_t &len) const;
+    void ReleaseKnobs() const;
+
 public:
     TCgroup(const std::vector<std::shared_ptr<TSubsystem>> subsystems,
             std::shared_ptr<TMount> m = nullptr);
@@ -38,6 +45,12 @@ public:
     std::shared_ptr<TMount> GetMount();
 
     TError Kill(int signal) const;
+    // Signals all tasks in frozen cgroup if it's in freezer hierarchy,
+    // so forking tasks can't escape, and thaws it back; given lock is
+    // released while waiting for freezer
+    TError KillAll(int signal, TScopedLock *lock = nullptr) const;
+    // Polls with growing interval until there are no tasks
+    bool WaitEmpty(int timeoutMs) const;
 
     TError FindChildren(std::vector<std::shared_ptr<TCgroup>> &cgroups);
 
@@ -49,6 +62,7 @@ public:
 
     bool HasKnob(const std::string &knob) const;
     TError GetKnobValue(const std::string &knob, std::string &value) const;
+    TError GetKnobValue(const std::string &knob, uint64_t &value) const;
     TError GetKnobValueAsLines(const std::string &knob, std::vector<std::string> &lines) const;
     TError SetKnobValue(const std::string &knob, const std::string &value, bool append = false) const;
 };
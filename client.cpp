@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 
@@ -6,7 +7,9 @@
 #include "client.hpp"
 #include "container.hpp"
 #include "holder.hpp"
+#include "epoll.hpp"
 #include "config.hpp"
+#include "statistics.hpp"
 #include "util/file.hpp"
 #include "util/log.hpp"
 #include "util/protobuf.hpp"
@@ -18,13 +21,25 @@ extern "C" {
 #include <unistd.h>
 };
 
-TClient::TClient(std::shared_ptr<TEpollLoop> loop, int fd) : TEpollSource(loop, fd) {
-    SetState(EClientState::ReadingLength);
+static std::mutex ClientsMutex;
+static std::set<TClient *> Clients;
+
+TClient::TClient(std::shared_ptr<TEpollLoop> loop, int fd) : TEpollSource(loop, fd),
+        RequestsQueued(0), RequestsServed(0), RequestsThrottled(0) {
+    Tokens = config().daemon().client_request_burst();
+    TokensUpdateMs = GetCurrentTimeMs();
+
     if (config().log().verbose())
         L() << "Client connected " << Fd << std::endl;
 }
 
 TClient::~TClient() {
+    {
+        std::lock_guard<std::mutex> lock(ClientsMutex);
+        Clients.erase(this);
+    }
+
+    Statistics->QueuedOutput -= Output.size() - OutputPos;
     if (config().log().verbose())
         L() << "Client disconnected " << Fd << std::endl;
     close(Fd);
@@ -46,14 +61,6 @@ const std::string& TClient::GetComm() const {
     return Comm;
 }
 
-void TClient::BeginRequest() {
-    RequestStartMs = GetCurrentTimeMs();
-}
-
-size_t TClient::GetRequestTime() {
-    return GetCurrentTimeMs() - RequestStartMs;
-}
-
 TError TClient::Identify(TContainerHolder &holder, bool full) {
     struct ucred cr;
     socklen_t len = sizeof(cr);
@@ -83,6 +90,9 @@ TError TClient::Identify(TContainerHolder &holder, bool full) {
                         << " : " << err << std::endl;
                 return err;
             }
+
+            std::lock_guard<std::mutex> lock(ClientsMutex);
+            Clients.insert(this);
         } else {
             if (Container.expired())
                 return TError(EError::Unknown, "Can't identify client (container is dead)");
@@ -164,11 +174,33 @@ bool TClient::Readonly() {
     return !Cred.IsPrivileged() && !Cred.MemberOf(CredConf.GetPortoGid());
 }
 
-void TClient::SetState(EClientState state) {
-    Pos = 0;
-    Length = 0;
+// Returns size of varint length prefix or zero if it isn't received yet
+size_t TClient::ParseLength(uint64_t &length) const {
+    const size_t maxHeader = 10;
+
+    length = 0;
+    for (size_t i = 0; i < maxHeader && BufferPos + i < BufferEnd; i++) {
+        uint8_t byte = Buffer[BufferPos + i];
+
+        length |= (uint64_t)(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0)
+            return i + 1;
+    }
+
+    if (BufferEnd - BufferPos >= maxHeader) {
+        length = UINT64_MAX;
+        return maxHeader;
+    }
+
+    return 0;
+}
+
+bool TClient::BufferedRequest() const {
+    uint64_t length;
+    size_t header = ParseLength(length);
 
-    State = state;
+    return header && (length > config().daemon().max_msg_len() ||
+                      BufferEnd - BufferPos - header >= length);
 }
 
 bool TClient::ReadRequest(rpc::TContainerRequest &req, bool &hangup) {
@@ -177,47 +209,313 @@ bool TClient::ReadRequest(rpc::TContainerRequest &req, bool &hangup) {
         return ReadDelimitedFrom(&InputStream, &req);
     }
 
-    while (State == EClientState::ReadingLength) {
-        uint8_t byte;
-        int ret = recv(Fd, &byte, sizeof(byte), MSG_DONTWAIT);
+    const size_t bufferSize = 16384;
+    uint64_t maxLength = config().daemon().max_msg_len();
+    uint64_t length;
+    size_t header = ParseLength(length);
+
+    if (!header || (length <= maxLength && BufferEnd - BufferPos - header < length)) {
+        if (BufferPos) {
+            memmove(&Buffer[0], &Buffer[BufferPos], BufferEnd - BufferPos);
+            BufferEnd -= BufferPos;
+            BufferPos = 0;
+        }
+
+        size_t size = std::max(bufferSize, header ? header + length : 0);
+        if (Buffer.size() < size)
+            Buffer.resize(size);
+
+        int ret = recv(Fd, &Buffer[BufferEnd], Buffer.size() - BufferEnd, MSG_DONTWAIT);
         if (ret <= 0)
             return false;
 
-        Length |= (byte & 0x7f) << Pos;
-        Pos += 7;
+        BufferEnd += ret;
 
-        if ((byte & 0x80) == 0) {
-            if (Length > config().daemon().max_msg_len()) {
-                L_WRN() << "Got oversized request " << Length << " from client " << Fd << std::endl;
-                SetState(EClientState::ReadingLength);
-                hangup = true;
-                return false;
-            }
+        header = ParseLength(length);
+        if (!header)
+            return false;
+    }
+
+    if (length > maxLength) {
+        L_WRN() << "Got oversized request " << length << " from client " << Fd << std::endl;
+        hangup = true;
+        return false;
+    }
+
+    if (BufferEnd - BufferPos - header < length)
+        return false;
+
+    bool ret = req.ParseFromArray(&Buffer[BufferPos + header], length);
+    if (!ret) {
+        L_WRN() << "Couldn't parse request from client " << Fd << std::endl;
+        hangup = true;
+    }
 
-            Request.Alloc(Length);
-            SetState(EClientState::ReadingData);
+    BufferPos += header + length;
+    if (BufferPos == BufferEnd) {
+        BufferPos = BufferEnd = 0;
+        if (Buffer.size() > bufferSize) {
+            Buffer.resize(bufferSize);
+            Buffer.shrink_to_fit();
         }
     }
 
-    if (State == EClientState::ReadingData) {
-        int ret = recv(Fd, (uint8_t *)Request.GetData() + Pos, Request.GetSize() - Pos, MSG_DONTWAIT);
-        if (ret <= 0)
+    return ret;
+}
+
+bool TClient::WriteResponse(rpc::TContainerResponse &rsp) {
+    if (config().daemon().blocking_write()) {
+        // pipelined requests are handled concurrently, don't mix up replies
+        std::lock_guard<std::mutex> lock(WriteMutex);
+
+        google::protobuf::io::FileOutputStream post(Fd);
+        if (!WriteDelimitedTo(rsp, &post))
+            return false;
+
+        return post.Flush();
+    }
+
+    std::string buf;
+    {
+        google::protobuf::io::StringOutputStream stream(&buf);
+        if (!WriteDelimitedTo(rsp, &stream))
             return false;
+    }
+
+    return QueueOutput(buf);
+}
+
+bool TClient::WriteResponse(const std::string &msg) {
+    std::string buf;
+    {
+        google::protobuf::io::StringOutputStream stream(&buf);
+        google::protobuf::io::CodedOutputStream output(&stream);
+        output.WriteVarint32(msg.size());
+        output.WriteString(msg);
+        if (output.HadError())
+            return false;
+    }
 
-        Pos += ret;
+    if (config().daemon().blocking_write()) {
+        std::lock_guard<std::mutex> lock(WriteMutex);
 
-        if (Pos >= Request.GetSize()) {
-            bool ret = req.ParseFromArray(Request.GetData(), Request.GetSize());
-            if (!ret) {
-                L_WRN() << "Couldn't parse request from client " << Fd << std::endl;
-                hangup = true;
+        for (size_t pos = 0; pos < buf.size(); ) {
+            ssize_t ret = write(Fd, buf.data() + pos, buf.size() - pos);
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
             }
-            SetState(EClientState::ReadingLength);
-            return ret;
+            pos += ret;
         }
+
+        return true;
+    }
+
+    return QueueOutput(buf);
+}
+
+bool TClient::QueueOutput(std::string &buf) {
+    auto lock = ScopedLock();
+    size_t queued = Output.size() - OutputPos;
+
+    if (queued + buf.size() > config().daemon().max_client_output()) {
+        L_WRN() << "Client " << Fd << " doesn't read responses, "
+                << queued << " bytes queued" << std::endl;
+        Statistics->OutputOverflows++;
+        // epoll loop will see hangup and drop client
+        shutdown(Fd, SHUT_RDWR);
+        errno = ENOBUFS;
+        return false;
     }
 
-    return false;
+    if (queued) {
+        Output.append(buf);
+        Statistics->QueuedOutput += buf.size();
+        return true;
+    }
+
+    Output = std::move(buf);
+    OutputPos = 0;
+    Statistics->QueuedOutput += Output.size();
+
+    // usually socket accepts whole response at once
+    if (!SendOutput())
+        return false;
+
+    if (OutputPos < Output.size()) {
+        TError error = UpdateEvents();
+        if (error) {
+            L_WRN() << "Can't poll client " << Fd << " for output: " << error << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TClient::SendOutput() {
+    while (OutputPos < Output.size()) {
+        ssize_t ret = send(Fd, Output.data() + OutputPos, Output.size() - OutputPos,
+                           MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+
+        OutputPos += ret;
+        Statistics->QueuedOutput -= ret;
+    }
+
+    Output.clear();
+    OutputPos = 0;
+    return true;
+}
+
+bool TClient::FlushOutput() {
+    auto lock = ScopedLock();
+
+    if (!SendOutput()) {
+        L_WRN() << "Can't send response to client " << Fd << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (OutputPos < Output.size()) {
+        // don't keep sent data around
+        if (OutputPos > Output.size() / 2) {
+            Output.erase(0, OutputPos);
+            OutputPos = 0;
+        }
+        return true;
+    }
+
+    TError error = UpdateEvents();
+    if (error) {
+        L_WRN() << "Can't update client " << Fd << " events: " << error << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+TError TClient::UpdateEvents() {
+    auto loop = EpollLoop.lock();
+    if (!loop)
+        return TError::Success();
+
+    return loop->ModifySource(*this, !Disabled, OutputPos < Output.size());
+}
+
+bool TClient::CanQueue() const {
+    // requests without id expect replies in order
+    return !InflightSerial &&
+        Inflight < config().daemon().max_pipelined_requests();
+}
+
+bool TClient::ConsumeToken() {
+    uint64_t rate = config().daemon().client_request_rate();
+    if (!rate)
+        return true;
+
+    auto lock = ScopedLock();
+    uint64_t now = GetCurrentTimeMs();
+    double burst = std::max(config().daemon().client_request_burst(), 1u);
+
+    Tokens = std::min(burst, Tokens + (now - TokensUpdateMs) * rate / 1000.0);
+    TokensUpdateMs = now;
+
+    if (Tokens < 1) {
+        RequestsThrottled++;
+        return false;
+    }
+
+    Tokens -= 1;
+    return true;
+}
+
+// Sums counters of all connections of each client process
+void TClient::GetStatistics(std::map<std::string, uint64_t> &stat) {
+    std::lock_guard<std::mutex> lock(ClientsMutex);
+
+    for (auto client : Clients) {
+        std::string comm = client->Comm;
+        std::replace_if(comm.begin(), comm.end(), [](char c) {
+            return c == ';' || c == ':' || c == '.';
+        }, '_');
+
+        std::string prefix = comm + "." + std::to_string(client->Pid) + ".";
+        stat[prefix + "queued"] += client->RequestsQueued;
+        stat[prefix + "served"] += client->RequestsServed;
+        stat[prefix + "throttled"] += client->RequestsThrottled;
+    }
+}
+
+bool TClient::CanRead() {
+    auto lock = ScopedLock();
+    return !Disabled;
+}
+
+bool TClient::IsIdle() {
+    auto lock = ScopedLock();
+    std::lock_guard<std::mutex> writeLock(WriteMutex);
+
+    return !Inflight && BufferPos == BufferEnd &&
+        OutputPos == Output.size() && Waiters.empty();
+}
+
+TError TClient::QueueRequest(bool pipelined, bool &more) {
+    auto lock = ScopedLock();
+
+    Inflight++;
+    if (!pipelined)
+        InflightSerial++;
+
+    more = CanQueue();
+    if (!more && !Disabled) {
+        Disabled = true;
+        TError error = UpdateEvents();
+        if (error) {
+            Disabled = false;
+            Inflight--;
+            if (!pipelined)
+                InflightSerial--;
+            return error;
+        }
+    }
+
+    return TError::Success();
+}
+
+void TClient::FinishRequest(bool pipelined) {
+    auto lock = ScopedLock();
+
+    PORTO_ASSERT(Inflight > 0);
+    Inflight--;
+    if (!pipelined) {
+        PORTO_ASSERT(InflightSerial > 0);
+        InflightSerial--;
+    }
+
+    if (!Disabled || !CanQueue())
+        return;
+
+    // epoll doesn't know about requests which are already received,
+    // check buffer while epoll thread cannot touch it
+    bool buffered = BufferedRequest();
+
+    Disabled = false;
+
+    TError error = UpdateEvents();
+    if (error)
+        L_WRN() << "Can't enable client " << Fd << ": " << error << std::endl;
+
+    auto loop = EpollLoop.lock();
+    if (loop && buffered) {
+        error = loop->WakeupSource(*this);
+        if (error)
+            L_WRN() << "Can't wakeup client " << Fd << ": " << error << std::endl;
+    }
 }
 
 std::ostream& operator<<(std::ostream& stream, TClient& client) {
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <mutex>
+#include <set>
+#include <map>
+#include <atomic>
 
 #include "common.hpp"
 #include "epoll.hpp"
@@ -15,14 +19,10 @@ class TEpollLoop;
 
 namespace rpc {
     class TContainerRequest;
+    class TContainerResponse;
 }
 
-enum class EClientState {
-    ReadingLength,
-    ReadingData,
-};
-
-class TClient : public TEpollSource {
+class TClient : public TEpollSource, public TLockable {
 public:
     TClient(std::shared_ptr<TEpollLoop> loop, int fd);
     ~TClient();
@@ -32,26 +32,60 @@ public:
     const TCred& GetCred() const;
     const std::string& GetComm() const;
 
-    void BeginRequest();
-    size_t GetRequestTime();
-
     TError Identify(TContainerHolder &holder, bool full = true);
     std::string GetContainerName() const;
     TError GetContainer(std::shared_ptr<TContainer> &container) const;
 
     friend std::ostream& operator<<(std::ostream& stream, TClient& client);
 
-    std::shared_ptr<TContainerWaiter> Waiter;
+    // changed under holder lock
+    std::set<std::shared_ptr<TContainerWaiter>> Waiters;
     bool Readonly();
 
     bool ReadRequest(rpc::TContainerRequest &req, bool &hangup);
-    bool ReadInterrupted();
+    bool BufferedRequest() const;
+    bool WriteResponse(rpc::TContainerResponse &rsp);
+    // writes already encoded response
+    bool WriteResponse(const std::string &msg);
+    bool FlushOutput();
+
+    // request counters, see porto_clients data
+    std::atomic<uint64_t> RequestsQueued;
+    std::atomic<uint64_t> RequestsServed;
+    std::atomic<uint64_t> RequestsThrottled;
+
+    // token bucket, true if request fits into rate limit
+    bool ConsumeToken();
+
+    static void GetStatistics(std::map<std::string, uint64_t> &stat);
+
+    // client isn't polled while it cannot queue more requests
+    bool CanRead();
+    // no request in progress or pending, call under holder lock
+    bool IsIdle();
+    TError QueueRequest(bool pipelined, bool &more);
+    void FinishRequest(bool pipelined);
 
 private:
-    pid_t Pid;
+    pid_t Pid = 0;
     TCred Cred;
     std::string Comm;
-    size_t RequestStartMs;
+
+    std::mutex WriteMutex;
+    size_t Inflight = 0;
+    size_t InflightSerial = 0;
+    bool Disabled = false;
+    bool CanQueue() const;
+
+    // serialized responses not yet accepted by socket, changed under lock
+    std::string Output;
+    size_t OutputPos = 0;
+    bool QueueOutput(std::string &buf);
+    bool SendOutput();
+    TError UpdateEvents();
+
+    double Tokens = 0;
+    uint64_t TokensUpdateMs = 0;
 
     TError LoadGroups();
     TError IdentifyContainer(TContainerHolder &holder);
@@ -59,10 +93,11 @@ private:
 
     bool FullLog = true;
 
-    EClientState State;
-    uint64_t Length;
-    uint64_t Pos;
-    TScopedMem Request;
+    // received but not yet parsed data, touched only by epoll thread
+    // or by worker which re-enables disabled client before enabling it
+    std::vector<uint8_t> Buffer;
+    size_t BufferPos = 0;
+    size_t BufferEnd = 0;
 
-    void SetState(EClientState state);
+    size_t ParseLength(uint64_t &length) const;
 };
@@ -46,6 +46,7 @@ void TConfig::LoadDefaults() {
     config().mutable_keyval()->mutable_file()->set_path("/run/porto/kvs");
     config().mutable_keyval()->mutable_file()->set_perm(0755);
     config().mutable_keyval()->set_size("size=32m");
+    config().mutable_keyval()->set_compact_records(4096);
 
     config().mutable_daemon()->set_max_clients(512);
     config().mutable_daemon()->set_cgroup_remove_timeout_s(5);
@@ -60,6 +61,18 @@ void TConfig::LoadDefaults() {
     config().mutable_daemon()->set_blocking_write(false);
     config().mutable_daemon()->set_event_workers(1);
     config().mutable_daemon()->set_debug(false);
+    config().mutable_daemon()->set_max_pipelined_requests(32);
+    config().mutable_daemon()->set_max_client_output(64 * 1024 * 1024);
+    config().mutable_daemon()->set_info_workers(4);
+    config().mutable_daemon()->set_volume_workers(2);
+    config().mutable_daemon()->set_client_request_rate(0);
+    config().mutable_daemon()->set_client_request_burst(100);
+    config().mutable_daemon()->set_metrics_sample_ms(0);
+    config().mutable_daemon()->set_max_knob_fds(1024);
+    config().mutable_daemon()->set_task_spawner(true);
+    config().mutable_daemon()->set_max_info_queue(4096);
+    config().mutable_daemon()->set_max_container_queue(1024);
+    config().mutable_daemon()->set_max_volume_queue(256);
 
     config().mutable_container()->set_max_log_size(10 * 1024 * 1024);
     config().mutable_container()->set_tmp_dir("/place/porto");
@@ -76,10 +89,12 @@ void TConfig::LoadDefaults() {
     config().mutable_container()->set_batch_io_weight(10);
     config().mutable_container()->set_empty_wait_timeout_ms(5000);
     config().mutable_container()->set_scoped_unlock(true);
+    config().mutable_container()->set_stop_threads(8);
 
     config().mutable_volumes()->mutable_keyval()->mutable_file()->set_path("/run/porto/pkvs");
     config().mutable_volumes()->mutable_keyval()->mutable_file()->set_perm(0755);
     config().mutable_volumes()->mutable_keyval()->set_size("size=32m");
+    config().mutable_volumes()->mutable_keyval()->set_compact_records(4096);
 
     config().mutable_volumes()->set_volume_dir("/place/porto_volumes");
     config().mutable_volumes()->set_layers_dir("/place/porto_layers");
@@ -4,6 +4,8 @@
 #include <csignal>
 #include <cstdlib>
 #include <algorithm>
+#include <thread>
+#include <condition_variable>
 
 #include "statistics.hpp"
 #include "container.hpp"
@@ -21,7 +23,9 @@
 #include "task.hpp"
 #include "epoll.hpp"
 #include "kvalue.hpp"
+#include "kv.pb.h"
 #include "volume.hpp"
+#include "metrics.hpp"
 #include "util/log.hpp"
 #include "util/file.hpp"
 #include "util/string.hpp"
@@ -51,12 +55,18 @@ using std::map;
 
 int64_t BootTime = 0;
 
+// Hierarchical properties with incrementally maintained children sums
+static const std::string SummedProperties[] = { P_MEM_GUARANTEE, P_MEM_LIMIT };
+
 TContainer::TContainer(std::shared_ptr<TContainerHolder> holder,
                        std::shared_ptr<TKeyValueStorage> storage,
                        const std::string &name, std::shared_ptr<TContainer> parent,
                        uint16_t id, std::shared_ptr<TNetwork> net) :
-    Holder(holder), Name(StripParentName(name)), Parent(parent),
-    Storage(storage), Id(id), Net(net) { }
+    Holder(holder), Name(StripParentName(name)), FullName(name), Parent(parent),
+    Storage(storage), Id(id), Net(net) {
+    for (auto &sum : ChildrenSums)
+        sum = 0;
+}
 
 TContainer::~TContainer() {
     // Tclass destructor should be called with TNetwork locked,
@@ -91,7 +101,7 @@ TPath TContainer::RootPath() const {
     if (IsRoot() || IsPortoRoot())
         return TPath("/");
 
-    TPath path(Prop->Get<std::string>(P_ROOT));
+    TPath path(Prop->Get(Props::Root));
     if (!path.IsRoot()) {
         if (path.GetType() == EFileType::Regular)
             path = GetTmpDir();
@@ -123,6 +133,22 @@ TError TContainer::GetStat(ETclassStat stat, std::map<std::string, uint64_t> &m)
     return Tclass->GetStat(stat, m);
 }
 
+void TContainer::SetMetrics(std::shared_ptr<const TContainerMetrics> metrics) {
+    Metrics.Store(metrics);
+}
+
+std::shared_ptr<const TContainerMetrics> TContainer::GetMetrics() const {
+    uint64_t staleness = TMetricsStalenessScope::MaxStalenessMs();
+    if (!staleness)
+        return nullptr;
+
+    auto metrics = Metrics.Load();
+    if (!metrics || metrics->SampleMs + staleness < GetCurrentTimeMs())
+        return nullptr;
+
+    return metrics;
+}
+
 void TContainer::UpdateRunningChildren(size_t diff) {
     RunningChildren += diff;
 
@@ -176,6 +202,10 @@ void TContainer::SetState(EContainerState newState) {
         UpdateRunningChildren(-1);
     }
 
+    // counters are reset by new cgroups
+    if (State == EContainerState::Stopped || newState == EContainerState::Stopped)
+        SetMetrics(nullptr);
+
     State = newState;
     Data->Set<std::string>(D_STATE, ContainerStateName(State));
 
@@ -238,12 +268,16 @@ void TContainer::DestroyVolumes(TScopedLock &holder_lock) {
 void TContainer::Destroy(TScopedLock &holder_lock) {
     L_ACT() << "Destroy " << GetName() << " " << Id << std::endl;
 
+    if (Prop)
+        for (auto &property : SummedProperties)
+            PropagateChildrenSum(property, -EffectiveValue(property));
+
     SetState(EContainerState::Unknown);
     DestroyVolumes(holder_lock);
     RemoveKvs();
 }
 
-const string TContainer::GetName(bool recursive, const std::string &sep) const {
+std::string TContainer::GetName(bool recursive, const std::string &sep) const {
     if (!recursive)
         return Name;
 
@@ -292,7 +326,53 @@ std::shared_ptr<TNlLink> TContainer::GetLink(const std::string &name) const {
     return nullptr;
 }
 
+std::atomic<uint64_t> *TContainer::ChildrenSum(const std::string &property) const {
+    for (size_t i = 0; i < sizeof(ChildrenSums) / sizeof(ChildrenSums[0]); i++)
+        if (property == SummedProperties[i])
+            return const_cast<std::atomic<uint64_t> *>(&ChildrenSums[i]);
+    return nullptr;
+}
+
+// Value accounted in parent's sum: own value or sum of children if unset
+uint64_t TContainer::EffectiveValue(const std::string &property) const {
+    uint64_t val = Prop->Get<uint64_t>(property);
+    return val ? val : ChildrenSum(property)->load();
+}
+
+// Add delta (wrapping, so negative works too) to sums of ancestors up to
+// the first one which has own value and thus doesn't change its effective one
+void TContainer::PropagateChildrenSum(const std::string &property, uint64_t delta) {
+    for (auto c = Parent; c && delta; c = c->Parent) {
+        *c->ChildrenSum(property) += delta;
+        if (c->Prop->Get<uint64_t>(property))
+            break;
+    }
+}
+
+// Called after own values were changed, prev holds old effective values
+void TContainer::UpdateChildrenSums(const std::map<std::string, uint64_t> &prev) {
+    for (auto &it : prev)
+        PropagateChildrenSum(it.first, EffectiveValue(it.first) - it.second);
+}
+
 uint64_t TContainer::GetChildrenSum(const std::string &property, std::shared_ptr<const TContainer> except, uint64_t exceptVal) const {
+    auto sum = ChildrenSum(property);
+    if (sum) {
+        uint64_t val = *sum;
+        if (!except)
+            return val;
+
+        // replace effective value of except and walk up to us
+        uint64_t delta = exceptVal - except->EffectiveValue(property);
+        for (auto c = except->GetParent(); c && delta; c = c->GetParent()) {
+            if (c.get() == this)
+                return val + delta;
+            if (c->Prop->Get<uint64_t>(property))
+                break;
+        }
+        return val;
+    }
+
     uint64_t val = 0;
 
     for (auto iter : Children)
@@ -352,13 +432,13 @@ TError TContainer::ApplyDynamicProperties() {
         //return error;
     }
 
-    error = memorySubsystem->SetGuarantee(memcg, Prop->Get<uint64_t>(P_MEM_GUARANTEE));
+    error = memorySubsystem->SetGuarantee(memcg, Prop->Get(Props::MemGuarantee));
     if (error) {
         L_ERR() << "Can't set " << P_MEM_GUARANTEE << ": " << error << std::endl;
         return error;
     }
 
-    error = memorySubsystem->SetLimit(memcg, Prop->Get<uint64_t>(P_MEM_LIMIT));
+    error = memorySubsystem->SetLimit(memcg, Prop->Get(Props::MemLimit));
     if (error) {
         if (error.GetErrno() == EBUSY)
             return TError(EError::InvalidValue, std::string(P_MEM_LIMIT) + " is too low");
@@ -367,27 +447,27 @@ TError TContainer::ApplyDynamicProperties() {
         return error;
     }
 
-    error = memorySubsystem->RechargeOnPgfault(memcg, Prop->Get<bool>(P_RECHARGE_ON_PGFAULT));
+    error = memorySubsystem->RechargeOnPgfault(memcg, Prop->Get(Props::RechargeOnPgfault));
     if (error) {
         L_ERR() << "Can't set " << P_RECHARGE_ON_PGFAULT << ": " << error << std::endl;
         return error;
     }
 
     auto cpucg = GetLeafCgroup(cpuSubsystem);
-    error = cpuSubsystem->SetPolicy(cpucg, Prop->Get<std::string>(P_CPU_POLICY));
+    error = cpuSubsystem->SetPolicy(cpucg, Prop->Get(Props::CpuPolicy));
     if (error) {
         L_ERR() << "Can't set " << P_CPU_POLICY << ": " << error << std::endl;
         return error;
     }
 
-    if (Prop->Get<std::string>(P_CPU_POLICY) == "normal") {
-        error = cpuSubsystem->SetLimit(cpucg, Prop->Get<uint64_t>(P_CPU_LIMIT));
+    if (Prop->Get(Props::CpuPolicy) == "normal") {
+        error = cpuSubsystem->SetLimit(cpucg, Prop->Get(Props::CpuLimit));
         if (error) {
             L_ERR() << "Can't set " << P_CPU_LIMIT << ": " << error << std::endl;
             return error;
         }
 
-        error = cpuSubsystem->SetGuarantee(cpucg, Prop->Get<uint64_t>(P_CPU_GUARANTEE));
+        error = cpuSubsystem->SetGuarantee(cpucg, Prop->Get(Props::CpuGuarantee));
         if (error) {
             L_ERR() << "Can't set " << P_CPU_GUARANTEE << ": " << error << std::endl;
             return error;
@@ -395,13 +475,13 @@ TError TContainer::ApplyDynamicProperties() {
     }
 
     auto blkcg = GetLeafCgroup(blkioSubsystem);
-    error = blkioSubsystem->SetPolicy(blkcg, Prop->Get<std::string>(P_IO_POLICY) == "batch");
+    error = blkioSubsystem->SetPolicy(blkcg, Prop->Get(Props::IoPolicy) == "batch");
     if (error) {
         L_ERR() << "Can't set " << P_IO_POLICY << ": " << error << std::endl;
         return error;
     }
 
-    error = memorySubsystem->SetIoLimit(memcg, Prop->Get<uint64_t>(P_IO_LIMIT));
+    error = memorySubsystem->SetIoLimit(memcg, Prop->Get(Props::IoLimit));
     if (error) {
         L_ERR() << "Can't set " << P_IO_LIMIT << ": " << error << std::endl;
         return error;
@@ -422,7 +502,7 @@ std::shared_ptr<TContainer> TContainer::FindRunningParent() const {
 }
 
 bool TContainer::UseParentNamespace() const {
-    if (Prop->GetRaw<bool>(P_ISOLATE))
+    if (Prop->GetRaw(Props::Isolate))
         return false;
 
     return FindRunningParent() != nullptr;
@@ -451,9 +531,9 @@ TError TContainer::PrepareNetwork() {
     }
 
     TUintMap prio, rate, ceil;
-    prio = Prop->Get<TUintMap>(P_NET_PRIO);
-    rate = Prop->Get<TUintMap>(P_NET_GUARANTEE);
-    ceil = Prop->Get<TUintMap>(P_NET_LIMIT);
+    prio = Prop->Get(Props::NetPrio);
+    rate = Prop->Get(Props::NetGuarantee);
+    ceil = Prop->Get(Props::NetLimit);
 
     Tclass->Prepare(prio, rate, ceil);
 
@@ -477,6 +557,21 @@ void TContainer::ShutdownOom() {
 TError TContainer::PrepareOomMonitor() {
     auto memcg = GetLeafCgroup(memorySubsystem);
 
+    // eventfd from previous slave is still registered and keeps OOMs
+    // which happened during update
+    auto it = Holder->OomFds.find(GetName());
+    if (it != Holder->OomFds.end()) {
+        Efd = it->second;
+        Holder->OomFds.erase(it);
+
+        Source = std::make_shared<TEpollSource>(Holder->EpollLoop, Efd.GetFd(),
+                                                EPOLL_EVENT_OOM, shared_from_this());
+        TError error = Holder->EpollLoop->AddSource(Source);
+        if (error)
+            ShutdownOom();
+        return error;
+    }
+
     Efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
     if (Efd.GetFd() < 0) {
         TError error(EError::Unknown, errno, "Can't create eventfd");
@@ -556,7 +651,7 @@ TError TContainer::PrepareCgroups() {
 
         auto devices = GetLeafCgroup(devicesSubsystem);
         error = devicesSubsystem->AllowDevices(devices,
-                                               Prop->Get<TStrList>(P_ALLOWED_DEVICES));
+                                               Prop->Get(Props::AllowedDevices));
         if (error) {
             L_ERR() << "Can't set " << P_ALLOWED_DEVICES << ": " << error << std::endl;
             return error;
@@ -570,9 +665,9 @@ bool TContainer::IsNamespaceIsolated() {
     if (IsRoot() || IsPortoRoot())
         return false;
 
-    if (Prop->Get<std::string>(P_ROOT) != "/" &&
-        !Prop->Get<std::string>(P_PORTO_NAMESPACE).empty() &&
-        Prop->Get<bool>(P_ENABLE_PORTO))
+    if (Prop->Get(Props::Root) != "/" &&
+        !Prop->Get(Props::PortoNamespace).empty() &&
+        Prop->Get(Props::EnablePorto))
         return true;
 
     if (Parent)
@@ -594,7 +689,7 @@ void TContainer::CleanupExpiredChildren() {
 }
 
 TError TContainer::PrepareTask(std::shared_ptr<TClient> client) {
-    if (!Prop->Get<bool>(P_ISOLATE))
+    if (!Prop->Get(Props::Isolate))
         for (auto name : Prop->List())
             if (Prop->Find(name)->GetFlags() & PARENT_RO_PROPERTY)
                 if (!Prop->IsDefault(name))
@@ -604,28 +699,28 @@ TError TContainer::PrepareTask(std::shared_ptr<TClient> client) {
 
     taskEnv->LeafCgroups = LeafCgroups;
 
-    taskEnv->Command = Prop->Get<std::string>(P_COMMAND);
-    taskEnv->Cwd = Prop->Get<std::string>(P_CWD);
+    taskEnv->Command = Prop->Get(Props::Command);
+    taskEnv->Cwd = Prop->Get(Props::Cwd);
 
-    TPath root(Prop->Get<std::string>(P_ROOT));
+    TPath root(Prop->Get(Props::Root));
     if (root.GetType() == EFileType::Directory) {
-        taskEnv->Root = Prop->Get<std::string>(P_ROOT);
+        taskEnv->Root = Prop->Get(Props::Root);
     } else {
         taskEnv->Root = GetTmpDir();
-        taskEnv->Loop = Prop->Get<std::string>(P_ROOT);
-        taskEnv->LoopDev = Prop->Get<int>(P_RAW_LOOP_DEV);
+        taskEnv->Loop = Prop->Get(Props::Root);
+        taskEnv->LoopDev = Prop->Get(Props::RawLoopDev);
     }
 
-    taskEnv->RootRdOnly = Prop->Get<bool>(P_ROOT_RDONLY);
+    taskEnv->RootRdOnly = Prop->Get(Props::RootRdOnly);
     taskEnv->CreateCwd = Prop->IsDefault(P_ROOT) && Prop->IsDefault(P_CWD) && !UseParentNamespace();
 
     TCred cred(OwnerCred);
-    auto vmode = Prop->Get<int>(P_VIRT_MODE);
+    auto vmode = Prop->Get(Props::VirtMode);
     if (vmode == VIRT_MODE_OS) {
         taskEnv->User = "root";
         cred.Uid = cred.Gid = 0;
     } else {
-        taskEnv->User = Prop->Get<std::string>(P_USER);
+        taskEnv->User = Prop->Get(Props::User);
     }
 
     std::map<std::string, std::string> portoEnv = {
@@ -633,11 +728,11 @@ TError TContainer::PrepareTask(std::shared_ptr<TClient> client) {
         { "container", "lxc" },
         { "PORTO_NAME", GetName() },
         { "PORTO_HOST", GetHostName() },
-        { "HOME", Prop->Get<std::string>(P_CWD) },
+        { "HOME", Prop->Get(Props::Cwd) },
         { "USER", taskEnv->User },
     };
 
-    taskEnv->Environ = Prop->Get<TStrList>(P_ENV);
+    taskEnv->Environ = Prop->Get(Props::Env);
     for (auto pair : portoEnv) {
         if (taskEnv->EnvHasKey(pair.first))
             continue;
@@ -645,12 +740,12 @@ TError TContainer::PrepareTask(std::shared_ptr<TClient> client) {
         taskEnv->Environ.push_back(pair.first + "=" + pair.second);
     }
 
-    taskEnv->Isolate = Prop->Get<bool>(P_ISOLATE);
-    taskEnv->StdinPath = Prop->Get<std::string>(P_STDIN_PATH);
-    taskEnv->StdoutPath = Prop->Get<std::string>(P_STDOUT_PATH);
-    taskEnv->StderrPath = Prop->Get<std::string>(P_STDERR_PATH);
-    taskEnv->Hostname = Prop->Get<std::string>(P_HOSTNAME);
-    taskEnv->BindDns = Prop->Get<bool>(P_BIND_DNS);
+    taskEnv->Isolate = Prop->Get(Props::Isolate);
+    taskEnv->StdinPath = Prop->Get(Props::StdinPath);
+    taskEnv->StdoutPath = Prop->Get(Props::StdoutPath);
+    taskEnv->StderrPath = Prop->Get(Props::StderrPath);
+    taskEnv->Hostname = Prop->Get(Props::Hostname);
+    taskEnv->BindDns = Prop->Get(Props::BindDns);
 
     if (client) {
         std::shared_ptr<TContainer> clientContainer;
@@ -683,7 +778,7 @@ TError TContainer::PrepareTask(std::shared_ptr<TClient> client) {
     if (error)
         return error;
 
-    if (Prop->Get<bool>(P_ENABLE_PORTO) && IsNamespaceIsolated()) {
+    if (Prop->Get(Props::EnablePorto) && IsNamespaceIsolated()) {
         TBindMap bm = { config().rpc_sock().file().path(),
                         config().rpc_sock().file().path(),
                         false };
@@ -746,7 +841,7 @@ TError TContainer::PrepareTask(std::shared_ptr<TClient> client) {
         if (StringEndsWith(path.ToString(), deleted))
             path = path.ToString().substr(0, path.ToString().length() - deleted.length());
 
-        taskEnv->Command = Prop->Get<std::string>(P_CWD) + "/portod-meta-root";
+        taskEnv->Command = Prop->Get(Props::Cwd) + "/portod-meta-root";
 
         TBindMap bm = { path.ToString() + "-meta-root",
                         "portod-meta-root",
@@ -791,16 +886,29 @@ TError TContainer::Create(const TCred &cred) {
         return error;
     }
 
+    error = Prop->Create();
+    if (error)
+        return error;
+
+    error = Data->Create();
+    if (error)
+        return error;
+
+    error = PrepareStorage();
+    if (error)
+        return error;
+
     OwnerCred = cred;
 
-    error = Prop->Set<std::string>(P_USER, cred.UserAsString());
+    error = Prop->Set(Props::User, cred.UserAsString());
     if (error)
         return error;
 
-    error = Prop->Set<std::string>(P_GROUP, cred.GroupAsString());
+    error = Prop->Set(Props::Group, cred.GroupAsString());
     if (error)
         return error;
 
+    UpdatePortoNamespace();
     SetState(EContainerState::Stopped);
 
     return TError::Success();
@@ -817,14 +925,14 @@ TError TContainer::Start(std::shared_ptr<TClient> client, bool meta) {
     if (error)
         return error;
 
-    auto vmode = Prop->Get<int>(P_VIRT_MODE);
+    auto vmode = Prop->Get(Props::VirtMode);
     if (vmode == VIRT_MODE_OS && !CredConf.PrivilegedUser(OwnerCred)) {
         for (auto name : Prop->List())
             if (Prop->Find(name)->GetFlags() & OS_MODE_PROPERTY)
                 Prop->Reset(name);
     }
 
-    if (!meta && !Prop->Get<std::string>(P_COMMAND).length())
+    if (!meta && !Prop->Get(Props::Command).length())
         return TError(EError::InvalidValue, "container command is empty");
 
     // since we now have a complete picture of properties, check
@@ -852,7 +960,7 @@ TError TContainer::Start(std::shared_ptr<TClient> client, bool meta) {
     if (error)
         return error;
 
-    error = Prop->Set<uint64_t>(P_RAW_START_TIME, GetCurrentTimeMs());
+    error = Prop->Set(Props::RawStartTime, GetCurrentTimeMs());
     if (error)
         return error;
 
@@ -860,8 +968,8 @@ TError TContainer::Start(std::shared_ptr<TClient> client, bool meta) {
     if (error)
         return error;
 
-    if (!meta || (meta && Prop->Get<bool>(P_ISOLATE))) {
-        TPath root(Prop->Get<std::string>(P_ROOT));
+    if (!meta || (meta && Prop->Get(Props::Isolate))) {
+        TPath root(Prop->Get(Props::Root));
         int loopNr = -1;
         if (root.GetType() != EFileType::Directory) {
             error = GetLoopDev(loopNr);
@@ -869,7 +977,7 @@ TError TContainer::Start(std::shared_ptr<TClient> client, bool meta) {
                 goto error;
         }
 
-        error = Prop->Set<int>(P_RAW_LOOP_DEV, loopNr);
+        error = Prop->Set(Props::RawLoopDev, loopNr);
         if (error) {
             if (loopNr >= 0)
                 (void)PutLoopDev(loopNr);
@@ -893,8 +1001,9 @@ TError TContainer::Start(std::shared_ptr<TClient> client, bool meta) {
             goto error;
 
         L() << GetName() << " started " << std::to_string(Task->GetPid()) << std::endl;
+        Holder->RegisterPid(Task->GetPid(), shared_from_this());
 
-        error = Prop->Set<int>(P_RAW_ROOT_PID, Task->GetPid());
+        error = Prop->Set(Props::RawRootPid, Task->GetPid());
         if (error)
             goto error;
     }
@@ -984,10 +1093,10 @@ TError TContainer::SendTreeSignal(TScopedLock &holder_lock, int signal) {
 
     ApplyForTreePostorder(holder_lock, [] (TScopedLock &holder_lock,
                                            TContainer &child) {
-        (void)child.SendSignal(SIGKILL);
+        (void)child.GetLeafCgroup(freezerSubsystem)->KillAll(SIGKILL, &holder_lock);
         return TError::Success();
     });
-    (void)SendSignal(SIGKILL);
+    (void)GetLeafCgroup(freezerSubsystem)->KillAll(SIGKILL, &holder_lock);
 
     return TError::Success();
 }
@@ -1008,9 +1117,7 @@ TError TContainer::KillAll(TScopedLock &holder_lock) {
     // try to stop all tasks gracefully
     if (!SendSignal(SIGTERM)) {
         TScopedUnlock unlock(holder_lock);
-        int ret = SleepWhile(config().container().kill_timeout_ms(),
-                             [&]{ return cg->IsEmpty() == false; });
-        if (ret)
+        if (!cg->WaitEmpty(config().container().kill_timeout_ms()))
             L() << "Child didn't exit via SIGTERM, sending SIGKILL" << std::endl;
     }
 
@@ -1069,6 +1176,96 @@ TError TContainer::ApplyForTreePostorder(TScopedLock &holder_lock,
     return TError::Success();
 }
 
+TError TContainer::ApplyForTreePostorderParallel(TScopedLock &holder_lock,
+                                std::function<TError (TScopedLock &holder_lock,
+                                                      TContainer &container)> fn) {
+    size_t threads = config().container().stop_threads();
+
+    // without scoped unlock workers would never get holder lock
+    if (threads < 2 || !config().container().scoped_unlock())
+        return ApplyForTreePostorder(holder_lock, fn);
+
+    struct TNode {
+        std::shared_ptr<TContainer> Container;
+        int Parent;
+        size_t Pending;
+    };
+    std::vector<TNode> nodes;
+
+    std::function<void(TContainer &, int)> collect = [&] (TContainer &c, int parent) {
+        for (auto iter : c.Children)
+            if (auto child = iter.lock()) {
+                int index = nodes.size();
+                nodes.push_back({child, parent, 0});
+                if (parent >= 0)
+                    nodes[parent].Pending++;
+                collect(*child, index);
+            }
+    };
+    collect(*this, -1);
+
+    if (nodes.empty())
+        return TError::Success();
+
+    std::vector<int> ready;
+    for (size_t i = 0; i < nodes.size(); i++)
+        if (!nodes[i].Pending)
+            ready.push_back(i);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t done = 0;
+    TError error;
+
+    auto worker = [&] {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            cv.wait(lock, [&] { return ready.size() || error || done == nodes.size(); });
+            if (error || done == nodes.size())
+                break;
+
+            int index = ready.back();
+            ready.pop_back();
+            lock.unlock();
+
+            TError err;
+            {
+                auto child = nodes[index].Container;
+                auto holder_lock = Holder->ScopedLock();
+                TNestedScopedLock child_lock(*child, holder_lock);
+                if (child->IsValid())
+                    err = fn(holder_lock, *child);
+            }
+
+            lock.lock();
+            if (err && !error)
+                error = err;
+
+            // parent goes after all its children
+            int parent = nodes[index].Parent;
+            if (parent >= 0 && !--nodes[parent].Pending)
+                ready.push_back(parent);
+
+            done++;
+            cv.notify_all();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    {
+        TScopedUnlock unlock(holder_lock);
+
+        for (size_t i = 0; i < std::min(threads, nodes.size()); i++)
+            workers.emplace_back(worker);
+
+        for (auto &thread : workers)
+            thread.join();
+    }
+
+    return error;
+}
+
 TError TContainer::PrepareResources() {
     TError error = PrepareNetwork();
     if (error) {
@@ -1110,6 +1307,8 @@ void TContainer::FreeResources() {
             L_ERR() << "Can't remove tc classifier: " << error << std::endl;
     }
     Tclass = nullptr;
+    if (Task)
+        Holder->UnregisterPid(Task->GetPid(), this);
     Task = nullptr;
     ShutdownOom();
 
@@ -1117,13 +1316,13 @@ void TContainer::FreeResources() {
         return;
 
     if (Prop->IsDefault(P_STDOUT_PATH))
-        RemoveLog(Prop->Get<std::string>(P_STDOUT_PATH));
+        RemoveLog(Prop->Get(Props::StdoutPath));
 
     if (Prop->IsDefault(P_STDERR_PATH))
-        RemoveLog(Prop->Get<std::string>(P_STDERR_PATH));
+        RemoveLog(Prop->Get(Props::StderrPath));
 
-    int loopNr = Prop->Get<int>(P_RAW_LOOP_DEV);
-    TError error = Prop->Set<int>(P_RAW_LOOP_DEV, -1);
+    int loopNr = Prop->Get(Props::RawLoopDev);
+    TError error = Prop->Set(Props::RawLoopDev, -1);
     if (error) {
         L_ERR() << "Can't set " << P_RAW_LOOP_DEV << ": " << error << std::endl;
     }
@@ -1182,13 +1381,13 @@ TError TContainer::Stop(TScopedLock &holder_lock) {
         auto cg = GetLeafCgroup(freezerSubsystem);
 
         TScopedUnlock unlock(holder_lock);
-        int ret = SleepWhile(config().container().stop_timeout_ms(),
-                             [&] () -> int {
-                                 if (cg && cg->IsEmpty())
-                                     return 0;
-                                 kill(Task->GetPid(), 0);
-                                 return errno != ESRCH;
-                             });
+        int ret = RetryBackoff(config().container().stop_timeout_ms(), 100,
+                               [&] () -> int {
+                                   if (cg && cg->IsEmpty())
+                                       return 0;
+                                   kill(Task->GetPid(), 0);
+                                   return errno != ESRCH;
+                               });
         if (ret) {
             L_ERR() << "Can't wait for container to stop" << std::endl;
             return TError(EError::Unknown, "Container didn't stop in " + std::to_string(config().container().stop_timeout_ms()) + "ms");
@@ -1301,7 +1500,8 @@ void TContainer::ParsePropertyName(std::string &name, std::string &idx) {
     idx = StringTrim(tokens[1], " \t\n]");
 }
 
-TError TContainer::GetData(const string &origName, string &value) {
+TError TContainer::GetData(const string &origName, string &value,
+                           std::shared_ptr<TClient> client) {
     std::string name = origName;
     std::string idx;
     ParsePropertyName(name, idx);
@@ -1313,6 +1513,11 @@ TError TContainer::GetData(const string &origName, string &value) {
     if (!cv->IsImplemented())
         return TError(EError::NotSupported, name + " is not implemented");
 
+    // e.g. porto_clients shows clients of all containers
+    if ((Data->Find(name)->GetFlags() & SUPERUSER_DATA) &&
+            !(client && client->GetCred().IsPrivileged()))
+        return TError(EError::Permission, "Only root can read " + name);
+
     auto validState = cv->GetState();
     if (validState.find(GetState()) == validState.end())
         return TError(EError::InvalidState, "invalid container state");
@@ -1477,7 +1682,7 @@ TError TContainer::SetProperty(const string &origProperty,
         return TError(EError::InvalidState, "Can't set dynamic property " + property + " in state " + ContainerStateName(GetState()));
 
     if (Parent && !Parent->IsRoot() && !Parent->IsPortoRoot() &&
-        !Prop->GetRaw<bool>(P_ISOLATE) && Prop->HasFlags(property, PARENT_RO_PROPERTY))
+        !Prop->GetRaw(Props::Isolate) && Prop->HasFlags(property, PARENT_RO_PROPERTY))
         return TError(EError::NotSupported, "Can't set " + property + " for child container");
 
     if (idx.length()) {
@@ -1500,9 +1705,18 @@ TError TContainer::SetProperty(const string &origProperty,
                 return error;
         }
     } else {
+        std::map<std::string, uint64_t> prev;
+        if (ChildrenSum(property))
+            prev[property] = EffectiveValue(property);
+
         error = Prop->FromString(property, value);
         if (error)
             return error;
+
+        UpdateChildrenSums(prev);
+
+        if (property == P_PORTO_NAMESPACE)
+            UpdatePortoNamespace();
     }
 
     if (ShouldApplyProperty(property)) {
@@ -1532,7 +1746,7 @@ TError TContainer::Prepare() {
     if (!IsRoot() && !IsPortoRoot())
         kvnode = Storage->GetNode(Id);
 
-    Prop = std::make_shared<TPropertyMap>(kvnode, shared_from_this());
+    Prop = std::make_shared<TPropertyMap>(kvnode);
     Data = std::make_shared<TValueMap>(kvnode);
     if (!Prop || !Data)
         throw std::bad_alloc();
@@ -1549,13 +1763,15 @@ TError TContainer::Prepare() {
                 return TError(EError::Unknown, "Data and property names conflict: " + name);
     }
 
-    TError error = Prop->Create();
-    if (error)
-        return error;
+    CgroupEmptySince = 0;
 
-    error = Data->Create();
-    if (error)
-        return error;
+    return TError::Success();
+}
+
+// Stores values which identify container, when restoring only missing
+// or wrong ones are written
+TError TContainer::PrepareStorage() {
+    TError error;
 
     if (!Data->HasValue(D_START_ERRNO)) {
         error = Data->Set<int>(D_START_ERRNO, -1);
@@ -1563,15 +1779,17 @@ TError TContainer::Prepare() {
             return error;
     }
 
-    error = Prop->Set<std::string>(P_RAW_NAME, GetName());
-    if (error)
-        return error;
-
-    error = Prop->Set<int>(P_RAW_ID, (int)Id);
-    if (error)
-        return error;
+    if (!Prop->HasValue(P_RAW_NAME) || Prop->Get(Props::RawName) != GetName()) {
+        error = Prop->Set(Props::RawName, GetName());
+        if (error)
+            return error;
+    }
 
-    CgroupEmptySince = 0;
+    if (!Prop->HasValue(P_RAW_ID) || Prop->Get(Props::RawId) != (int)Id) {
+        error = Prop->Set(Props::RawId, (int)Id);
+        if (error)
+            return error;
+    }
 
     return TError::Success();
 }
@@ -1583,29 +1801,49 @@ TError TContainer::Restore(TScopedLock &holder_lock, const kv::TNode &node) {
     if (error)
         return error;
 
+    std::map<std::string, uint64_t> prev;
+    for (auto &property : SummedProperties)
+        prev[property] = ChildrenSum(property)->load();
+
     error = Prop->Restore(node);
     if (error)
         return error;
 
+    UpdateChildrenSums(prev);
+    UpdatePortoNamespace();
+
     error = Data->Restore(node);
     if (error)
         return error;
 
-    error = Prop->Flush();
+    error = PrepareStorage();
     if (error)
         return error;
 
-    error = Data->Flush();
-    if (error)
-        return error;
+    // rewrite node only if it doesn't match restored values,
+    // e.g. when it was written by older version
+    kv::TNode synced;
+    Prop->Dump(synced);
+    Data->Dump(synced);
 
-    error = Prop->Sync();
-    if (error)
-        return error;
+    if (!TKeyValueStorage::Equal(node, synced)) {
+        error = Prop->Flush();
+        if (error)
+            return error;
 
-    error = Data->Sync();
-    if (error)
-        return error;
+        error = Data->Flush();
+        if (error)
+            return error;
+
+        error = Prop->Sync();
+        if (error)
+            return error;
+
+        error = Data->Sync();
+        if (error)
+            return error;
+    } else
+        Statistics->RestoreSyncSkipped++;
 
     // There are several points where we save value to the persistent store
     // which we may use as indication for events like:
@@ -1628,7 +1866,7 @@ TError TContainer::Restore(TScopedLock &holder_lock, const kv::TNode &node) {
 
     bool started = Prop->HasValue(P_RAW_ROOT_PID);
     if (started) {
-        int pid = Prop->Get<int>(P_RAW_ROOT_PID);
+        int pid = Prop->Get(Props::RawRootPid);
         if (pid == GetPid())
             pid = 0;
 
@@ -1640,7 +1878,7 @@ TError TContainer::Restore(TScopedLock &holder_lock, const kv::TNode &node) {
                 parent->GetState() == EContainerState::Meta ||
                 parent->GetState() == EContainerState::Dead)
                 break;
-            bool meta = parent->Prop->Get<std::string>(P_COMMAND).empty();
+            bool meta = parent->Prop->Get(Props::Command).empty();
 
             L() << "Start parent " << parent->GetName() << " meta " << meta << std::endl;
 
@@ -1662,6 +1900,7 @@ TError TContainer::Restore(TScopedLock &holder_lock, const kv::TNode &node) {
         }
 
         Task->Restore(pid);
+        Holder->RegisterPid(pid, shared_from_this());
 
         if (Task->HasCorrectParent()) {
             if (Task->IsZombie()) {
@@ -1693,16 +1932,16 @@ TError TContainer::Restore(TScopedLock &holder_lock, const kv::TNode &node) {
             // we started recording death time since porto v1.15,
             // use some sensible default
             if (!Prop->HasValue(P_RAW_DEATH_TIME))
-                Prop->Set<uint64_t>(P_RAW_DEATH_TIME, GetCurrentTimeMs());
+                Prop->Set(Props::RawDeathTime, GetCurrentTimeMs());
 
             SetState(EContainerState::Dead);
         } else {
             // we started recording start time since porto v1.15,
             // use some sensible default
             if (!Prop->HasValue(P_RAW_START_TIME))
-                Prop->Set<uint64_t>(P_RAW_START_TIME, GetCurrentTimeMs());
+                Prop->Set(Props::RawStartTime, GetCurrentTimeMs());
 
-            if (Prop->Get<std::string>(P_COMMAND).empty())
+            if (Prop->Get(Props::Command).empty())
                 SetState(EContainerState::Meta);
             else
                 SetState(EContainerState::Running);
@@ -1734,9 +1973,9 @@ TError TContainer::Restore(TScopedLock &holder_lock, const kv::TNode &node) {
 
     if (GetState() == EContainerState::Stopped) {
         if (Prop->IsDefault(P_STDOUT_PATH))
-            RemoveLog(Prop->Get<std::string>(P_STDOUT_PATH));
+            RemoveLog(Prop->Get(Props::StdoutPath));
         if (Prop->IsDefault(P_STDERR_PATH))
-            RemoveLog(Prop->Get<std::string>(P_STDERR_PATH));
+            RemoveLog(Prop->Get(Props::StderrPath));
     }
 
     if (Task)
@@ -1767,7 +2006,7 @@ void TContainer::ExitTree(TScopedLock &holder_lock, int status, bool oomKilled)
             << status << (oomKilled ? " invoked by OOM" : "")
             << std::endl;
 
-    if (!oomKilled && !Processes().empty() && Prop->Get<bool>(P_ISOLATE) == true) {
+    if (!oomKilled && !Processes().empty() && Prop->Get(Props::Isolate) == true) {
         L_WRN() << "Skipped bogus exit event (" << status << "), some process is still alive in " << GetName() << std::endl;
         return;
     }
@@ -1810,7 +2049,7 @@ void TContainer::Exit(TScopedLock &holder_lock, int status, bool oomKilled) {
     if (error)
         L_ERR() << "Can't set " << D_EXIT_STATUS << ": " << error << std::endl;
 
-    error = Prop->Set<uint64_t>(P_RAW_DEATH_TIME, GetCurrentTimeMs());
+    error = Prop->Set(Props::RawDeathTime, GetCurrentTimeMs());
     if (error)
         L_ERR() << "Can't set " << P_RAW_DEATH_TIME << ": " << error << std::endl;
 
@@ -1826,16 +2065,17 @@ void TContainer::Exit(TScopedLock &holder_lock, int status, bool oomKilled) {
             L_WRN() << "Can't kill all tasks in container: " << error << std::endl;
     }
 
-    if (!Prop->Get<bool>(P_ISOLATE)) {
+    if (!Prop->Get(Props::Isolate)) {
         TError error = KillAll(holder_lock);
         if (error)
             L_WRN() << "Can't kill all tasks in non-isolated container: " << error << std::endl;
     }
 
     Task->Exit(status);
+    Holder->UnregisterPid(Task->GetPid(), this);
     SetState(EContainerState::Dead);
 
-    error = Prop->Set<int>(P_RAW_ROOT_PID, 0);
+    error = Prop->Set(Props::RawRootPid, 0);
     if (error)
         L_ERR() << "Can't set " << P_RAW_ROOT_PID << ": " << error << std::endl;
 
@@ -1860,10 +2100,10 @@ bool TContainer::MayRespawn() {
     if (GetState() != EContainerState::Dead)
         return false;
 
-    if (!Prop->Get<bool>(P_RESPAWN))
+    if (!Prop->Get(Props::Respawn))
         return false;
 
-    return Prop->Get<int>(P_MAX_RESPAWNS) < 0 || Data->Get<uint64_t>(D_RESPAWN_COUNT) < (uint64_t)Prop->Get<int>(P_MAX_RESPAWNS);
+    return Prop->Get(Props::MaxRespawns) < 0 || Data->Get<uint64_t>(D_RESPAWN_COUNT) < (uint64_t)Prop->Get(Props::MaxRespawns);
 }
 
 bool TContainer::MayReceiveOom(int fd) {
@@ -1905,18 +2145,8 @@ TError TContainer::Respawn(TScopedLock &holder_lock) {
 
 bool TContainer::CanRemoveDead() const {
     return State == EContainerState::Dead &&
-        Prop->Get<uint64_t>(P_RAW_DEATH_TIME) / 1000 +
-        Prop->Get<uint64_t>(P_AGING_TIME) <= GetCurrentTimeMs() / 1000;
-}
-
-std::vector<std::string> TContainer::GetChildren() {
-    std::vector<std::string> vec;
-
-    for (auto weakChild : Children)
-        if (auto child = weakChild.lock())
-            vec.push_back(child->GetName());
-
-    return vec;
+        Prop->Get(Props::RawDeathTime) / 1000 +
+        Prop->Get(Props::AgingTime) <= GetCurrentTimeMs() / 1000;
 }
 
 TError TContainer::RotateLog(const TPath &path) {
@@ -1941,11 +2171,11 @@ void TContainer::DeliverEvent(TScopedLock &holder_lock, const TEvent &event) {
             break;
         case EEventType::RotateLogs:
             if (GetState() == EContainerState::Running && Task) {
-                TError error = RotateLog(Prop->Get<std::string>(P_STDOUT_PATH));
+                TError error = RotateLog(Prop->Get(Props::StdoutPath));
                 if (error)
                     L_ERR() << "Can't rotate stdout: " << error << std::endl;
 
-                error = RotateLog(Prop->Get<std::string>(P_STDERR_PATH));
+                error = RotateLog(Prop->Get(Props::StderrPath));
                 if (error)
                     L_ERR() << "Can't rotate stderr: " << error << std::endl;
             }
@@ -1982,28 +2212,37 @@ TError TContainer::CheckPermission(const TCred &ucred) {
 }
 
 std::string TContainer::GetPortoNamespace() const {
+    return *PortoNamespace.Load();
+}
+
+void TContainer::UpdatePortoNamespace() {
+    std::string ns;
     if (Parent)
-        return Parent->GetPortoNamespace() + Prop->Get<std::string>(P_PORTO_NAMESPACE);
-    else
-        return "";
+        ns = Parent->GetPortoNamespace() + Prop->Get(Props::PortoNamespace);
+    PortoNamespace.Store(std::make_shared<const std::string>(ns));
+
+    for (auto &weakChild : Children)
+        if (auto child = weakChild.lock())
+            child->UpdatePortoNamespace();
 }
 
 TError TContainer::RelativeName(const TContainer &c, std::string &name) const {
-    std::string ns = GetPortoNamespace();
+    auto ns = PortoNamespace.Load();
+    const std::string &n = c.FullName;
+
     if (c.IsRoot()) {
         name = ROOT_CONTAINER;
         return TError::Success();
-    } else if (ns == "") {
-        name = c.GetName();
+    } else if (ns->empty()) {
+        name = n;
         return TError::Success();
     } else {
-        std::string n = c.GetName();
-        if (n.length() <= ns.length() || n.compare(0, ns.length(), ns) != 0) {
+        if (n.length() <= ns->length() || n.compare(0, ns->length(), *ns) != 0) {
             return TError(EError::ContainerDoesNotExist,
-                          "Can't access container " + n + " from namespace " + ns);
+                          "Can't access container " + n + " from namespace " + *ns);
         }
 
-        name = n.substr(ns.length());
+        name.assign(n, ns->length(), std::string::npos);
         return TError::Success();
     }
 }
@@ -2015,17 +2254,20 @@ TError TContainer::AbsoluteName(const std::string &orig, std::string &name,
         return TError(EError::Permission,
                       "Meta containers (like . and /) are provided in read-only mode");
 
-    std::string ns = GetPortoNamespace();
+    auto ns = PortoNamespace.Load();
     if (orig == ROOT_CONTAINER || orig == PORTO_ROOT_CONTAINER)
         name = orig;
     else if (orig == DOT_CONTAINER) {
-        size_t off = ns.rfind('/');
+        size_t off = ns->rfind('/');
         if (off != std::string::npos) {
-            name = ns.substr(0, off);
+            name = ns->substr(0, off);
         } else
             name = PORTO_ROOT_CONTAINER;
-    } else
-        name = ns + orig;
+    } else {
+        name.reserve(ns->length() + orig.length());
+        name.assign(*ns);
+        name.append(orig);
+    }
 
     return TError::Success();
 }
@@ -2063,9 +2305,9 @@ void TContainer::CleanupWaiters() {
 TError TContainer::UpdateNetwork() {
     if (Tclass) {
         TUintMap prio, rate, ceil;
-        prio = Prop->Get<TUintMap>(P_NET_PRIO);
-        rate = Prop->Get<TUintMap>(P_NET_GUARANTEE);
-        ceil = Prop->Get<TUintMap>(P_NET_LIMIT);
+        prio = Prop->Get(Props::NetPrio);
+        rate = Prop->Get(Props::NetGuarantee);
+        ceil = Prop->Get(Props::NetLimit);
 
         Tclass->Prepare(prio, rate, ceil);
 
@@ -2132,7 +2374,12 @@ void TContainerWaiter::Signal(const TContainer *who) {
             Callback(client, err, name);
         }
 
-        client->Waiter = nullptr;
+        for (auto it = client->Waiters.begin(); it != client->Waiters.end(); it++) {
+            if (it->get() == this) {
+                client->Waiters.erase(it);
+                break;
+            }
+        }
     }
 }
 
@@ -2143,8 +2390,8 @@ TError TContainer::StopTree(TScopedLock &holder_lock) {
             return error;
     }
 
-    TError error = ApplyForTreePostorder(holder_lock, [&] (TScopedLock &holder_lock,
-                                                           TContainer &child) {
+    TError error = ApplyForTreePostorderParallel(holder_lock, [&] (TScopedLock &holder_lock,
+                                                                   TContainer &child) {
         if (child.IsFrozen()) {
             TError error = child.Unfreeze(holder_lock);
             if (error)
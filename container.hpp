@@ -4,6 +4,7 @@
 #include <vector>
 #include <memory>
 #include <set>
+#include <atomic>
 
 #include "util/unix.hpp"
 #include "util/locks.hpp"
@@ -26,6 +27,7 @@ class TContainerWaiter;
 class TClient;
 class TVolume;
 class TVolumeHolder;
+struct TContainerMetrics;
 
 namespace kv {
     class TNode;
@@ -47,11 +49,13 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
                    public TLockable {
     std::shared_ptr<TContainerHolder> Holder;
     const std::string Name;
+    const std::string FullName;
     const std::shared_ptr<TContainer> Parent;
     std::shared_ptr<TTclass> Tclass;
     std::vector<std::weak_ptr<TContainer>> Children;
     std::shared_ptr<TKeyValueStorage> Storage;
-    EContainerState State = EContainerState::Unknown;
+    // read without container lock when listing
+    std::atomic<EContainerState> State{EContainerState::Unknown};
     int Acquired = 0;
     uint16_t Id;
     int TaskStartErrno = -1;
@@ -65,6 +69,18 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
     std::map<std::shared_ptr<TSubsystem>, std::shared_ptr<TCgroup>> LeafCgroups;
     std::shared_ptr<TEpollSource> Source;
     bool IsMeta = false;
+    TAtomicSharedPtr<const TContainerMetrics> Metrics; // set by sampler
+    // porto_namespace of all parents and self
+    TAtomicSharedPtr<const std::string> PortoNamespace{
+        std::make_shared<const std::string>()};
+    void UpdatePortoNamespace();
+
+    // sums of children values of memory_guarantee and memory_limit
+    std::atomic<uint64_t> ChildrenSums[2];
+    std::atomic<uint64_t> *ChildrenSum(const std::string &property) const;
+    uint64_t EffectiveValue(const std::string &property) const;
+    void PropagateChildrenSum(const std::string &property, uint64_t delta);
+    void UpdateChildrenSums(const std::map<std::string, uint64_t> &prev);
 
     std::ofstream JournalStream;
 
@@ -72,7 +88,6 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
     void UpdateRunningChildren(size_t diff);
     TError UpdateSoftLimit();
     void SetState(EContainerState newState);
-    std::string ContainerStateName(EContainerState state);
 
     TError ApplyDynamicProperties();
     TError PrepareNetwork();
@@ -99,6 +114,7 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
     void Exit(TScopedLock &holder_lock, int status, bool oomKilled);
 
     TError Prepare();
+    TError PrepareStorage();
 
     void CleanupWaiters();
     void NotifyWaiters();
@@ -111,6 +127,11 @@ class TContainer : public std::enable_shared_from_this<TContainer>,
     TError ApplyForTreePostorder(TScopedLock &holder_lock,
                                  std::function<TError (TScopedLock &holder_lock,
                                                        TContainer &container)> fn);
+    // same order, but independent subtrees are processed by several threads,
+    // each of them takes holder lock and container lock for fn
+    TError ApplyForTreePostorderParallel(TScopedLock &holder_lock,
+                                         std::function<TError (TScopedLock &holder_lock,
+                                                               TContainer &container)> fn);
 
     void DestroyVolumes(TScopedLock &holder_lock);
 
@@ -130,8 +151,13 @@ public:
     TPath GetTmpDir() const;
     TPath RootPath() const;
     EContainerState GetState() const;
+    static std::string ContainerStateName(EContainerState state);
     TError GetStat(ETclassStat stat, std::map<std::string, uint64_t> &m);
 
+    void SetMetrics(std::shared_ptr<const TContainerMetrics> metrics);
+    // sampled metrics if accepted by current request, otherwise nullptr
+    std::shared_ptr<const TContainerMetrics> GetMetrics() const;
+
     TContainer(std::shared_ptr<TContainerHolder> holder,
                std::shared_ptr<TKeyValueStorage> storage,
                const std::string &name, std::shared_ptr<TContainer> parent,
@@ -145,8 +171,10 @@ public:
     void Release();
     bool IsAcquired() const;
 
-    const std::string GetName(bool recursive = true, const std::string &sep = "/") const;
+    const std::string &GetName() const { return FullName; }
+    std::string GetName(bool recursive, const std::string &sep) const;
     const uint16_t GetId() const { return Id; }
+    int GetOomFd() const { return Efd.GetFd(); }
 
     bool IsRoot() const;
     bool IsPortoRoot() const;
@@ -178,12 +206,12 @@ public:
     TError SetProperty(const std::string &property,
                        const std::string &value, std::shared_ptr<TClient> client);
 
-    TError GetData(const std::string &data, std::string &value);
+    TError GetData(const std::string &data, std::string &value,
+                   std::shared_ptr<TClient> client);
     TError Restore(TScopedLock &holder_lock, const kv::TNode &node);
 
     std::shared_ptr<TCgroup> GetLeafCgroup(std::shared_ptr<TSubsystem> subsys);
     bool CanRemoveDead() const;
-    std::vector<std::string> GetChildren();
     std::shared_ptr<TContainer> FindRunningParent() const;
     bool UseParentNamespace() const;
     void DeliverEvent(TScopedLock &holder_lock, const TEvent &event);
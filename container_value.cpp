@@ -2,14 +2,14 @@
 #include "container_value.hpp"
 #include "value.hpp"
 
-void AddContainerValue(std::shared_ptr<TRawValueMap> m, std::shared_ptr<TContainer> c, TAbstractValue *av) {
-    auto cv = ToContainerValue(av);
-    cv->SetContainer(c);
-    m->Add(cv->GetName(), av);
+void AddContainerValue(TValueTable &table, TAbstractValue *av) {
+    table.Add(ToContainerValue(av)->GetName(), av);
 }
 
 std::shared_ptr<TContainer> TContainerValue::GetContainer() const {
-    std::shared_ptr<TContainer> container = Container.lock();
+    auto map = TValueScope::Current();
+    PORTO_ASSERT(map != nullptr);
+    std::shared_ptr<TContainer> container = map->GetContainer();
     PORTO_ASSERT(container != nullptr);
     return container;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "value.hpp"
 #include "util/log.hpp"
 
 class TTaskEnv;
@@ -9,7 +10,6 @@ protected:
     const char *Name;
     const char *Desc;
     const std::set<EContainerState> State;
-    std::weak_ptr<TContainer> Container;
     bool Implemented = true;
 
     TContainerValue(
@@ -18,12 +18,10 @@ protected:
            const std::set<EContainerState> &state) :
         Name(name), Desc(desc), State(state) {}
 
+    // container which values are currently accessed
     std::shared_ptr<TContainer> GetContainer() const;
 
 public:
-    void SetContainer(std::shared_ptr<TContainer> container) {
-        Container = container;
-    }
     const char *GetName() const { return Name; }
     const char *GetDesc() const { return Desc; }
     const std::set<EContainerState> &GetState() const { return State; }
@@ -31,8 +29,11 @@ public:
     virtual bool IsImplemented() { return Implemented; }
 };
 
-class TRawValueMap;
-class TAbstractValue;
-
-void AddContainerValue(std::shared_ptr<TRawValueMap> m, std::shared_ptr<TContainer> c, TAbstractValue *av);
+void AddContainerValue(TValueTable &table, TAbstractValue *av);
 TContainerValue *ToContainerValue(TAbstractValue *av);
+
+template<typename T, typename V>
+void AddContainerValue(TValueTable &table, const TValueKey<T> &key, V *av) {
+    PORTO_ASSERT(std::string(ToContainerValue(av)->GetName()) == key.Name);
+    table.Add(key, av);
+}
@@ -12,8 +12,10 @@
 #include "util/mount.hpp"
 
 TContext::TContext() {
-    Storage = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().keyval().file().path(), "tmpfs", { config().keyval().size() }));
-    VolumeStorage = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().volumes().keyval().file().path(), "tmpfs", { config().volumes().keyval().size() }));
+    Storage = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().keyval().file().path(), "tmpfs", { config().keyval().size() }),
+                                                 config().keyval().compact_records());
+    VolumeStorage = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().volumes().keyval().file().path(), "tmpfs", { config().volumes().keyval().size() }),
+                                                       config().volumes().keyval().compact_records());
     Net = std::make_shared<TNetwork>();
     EpollLoop = std::make_shared<TEpollLoop>();
     Cholder = std::make_shared<TContainerHolder>(EpollLoop, Net, Storage);
@@ -59,12 +61,15 @@ TError TContext::Initialize() {
         return error;
 
     // don't fail, try to recover anyway
-    error = Storage->MountTmpfs();
-    if (error)
-        L_ERR() << "Can't create key-value storage, skipping recovery: " << error << std::endl;
-    error = VolumeStorage->MountTmpfs();
-    if (error)
-        L_ERR() << "Can't create key-value storage, skipping recovery: " << error << std::endl;
+    for (auto storage : { Storage, VolumeStorage }) {
+        error = storage->MountTmpfs();
+        if (error)
+            L_ERR() << "Can't create key-value storage: " << error << std::endl;
+        // journal works in plain directory too, keep running anyway
+        error = storage->OpenJournal();
+        if (error)
+            L_ERR() << "Can't open key-value journal: " << error << std::endl;
+    }
 
     if (config().network().enabled()) {
         if (config().network().dynamic_ifaces()) {
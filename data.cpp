@@ -8,6 +8,8 @@
 #include "subsystem.hpp"
 #include "qdisc.hpp"
 #include "cgroup.hpp"
+#include "client.hpp"
+#include "metrics.hpp"
 #include "util/file.hpp"
 #include "util/string.hpp"
 #include "config.hpp"
@@ -130,7 +132,7 @@ public:
         if (!c->Prop->HasValue(P_RAW_ROOT_PID))
             return -1;
 
-        return c->Prop->Get<int>(P_RAW_ROOT_PID);
+        return c->Prop->Get(Props::RawRootPid);
     }
 };
 
@@ -174,8 +176,8 @@ public:
 
     std::string GetDefault() const override {
         auto c = GetContainer();
-        return ReadStdio(c->Prop->Get<std::string>(P_STDOUT_PATH),
-                         c->Prop->Get<uint64_t>(P_STDOUT_LIMIT));
+        return ReadStdio(c->Prop->Get(Props::StdoutPath),
+                         c->Prop->Get(Props::StdoutLimit));
     }
 };
 
@@ -189,8 +191,8 @@ public:
 
     std::string GetDefault() const override {
         auto c = GetContainer();
-        return ReadStdio(c->Prop->Get<std::string>(P_STDERR_PATH),
-                         c->Prop->Get<uint64_t>(P_STDOUT_LIMIT));
+        return ReadStdio(c->Prop->Get(Props::StderrPath),
+                         c->Prop->Get(Props::StdoutLimit));
     }
 };
 
@@ -203,6 +205,10 @@ public:
                         rpdmState) {}
 
     uint64_t GetDefault() const override {
+        auto metrics = GetContainer()->GetMetrics();
+        if (metrics)
+            return metrics->CpuUsage;
+
         auto subsys = cpuacctSubsystem;
         auto cg = GetContainer()->GetLeafCgroup(subsys);
         if (!cg) {
@@ -230,6 +236,10 @@ public:
                         rpdmState) {}
 
     uint64_t GetDefault() const override {
+        auto metrics = GetContainer()->GetMetrics();
+        if (metrics)
+            return metrics->MemoryUsage;
+
         auto subsys = memorySubsystem;
         auto cg = GetContainer()->GetLeafCgroup(subsys);
         if (!cg) {
@@ -259,6 +269,10 @@ public:
     }
 
     TUintMap GetDefault() const override {
+        auto metrics = GetContainer()->GetMetrics();
+        if (metrics && metrics->HaveNet)
+            return metrics->NetBytes;
+
         TUintMap m;
         (void)GetContainer()->GetStat(ETclassStat::Bytes, m);
         return m;
@@ -363,6 +377,10 @@ public:
                         rpdmState) {}
 
     TUintMap GetDefault() const override {
+        auto metrics = GetContainer()->GetMetrics();
+        if (metrics)
+            return metrics->IoRead;
+
         TUintMap m;
         auto cg = GetContainer()->GetLeafCgroup(blkioSubsystem);
 
@@ -389,6 +407,10 @@ public:
                         rpdmState) {}
 
     TUintMap GetDefault() const override {
+        auto metrics = GetContainer()->GetMetrics();
+        if (metrics)
+            return metrics->IoWrite;
+
         TUintMap m;
         auto cg = GetContainer()->GetLeafCgroup(blkioSubsystem);
 
@@ -428,18 +450,18 @@ public:
 
         // we started recording raw start/death time since porto v1.15;
         // in case we updated from old version, return zero
-        if (!c->Prop->Get<uint64_t>(P_RAW_START_TIME))
-            c->Prop->Set<uint64_t>(P_RAW_START_TIME, GetCurrentTimeMs());
+        if (!c->Prop->Get(Props::RawStartTime))
+            c->Prop->Set(Props::RawStartTime, GetCurrentTimeMs());
 
-        if (!c->Prop->Get<uint64_t>(P_RAW_DEATH_TIME))
-            c->Prop->Set<uint64_t>(P_RAW_DEATH_TIME, GetCurrentTimeMs());
+        if (!c->Prop->Get(Props::RawDeathTime))
+            c->Prop->Set(Props::RawDeathTime, GetCurrentTimeMs());
 
         if (c->GetState() == EContainerState::Dead)
-            return (c->Prop->Get<uint64_t>(P_RAW_DEATH_TIME) -
-                    c->Prop->Get<uint64_t>(P_RAW_START_TIME)) / 1000;
+            return (c->Prop->Get(Props::RawDeathTime) -
+                    c->Prop->Get(Props::RawStartTime)) / 1000;
         else
             return (GetCurrentTimeMs() -
-                    c->Prop->Get<uint64_t>(P_RAW_START_TIME)) / 1000;
+                    c->Prop->Get(Props::RawStartTime)) / 1000;
     }
 };
 
@@ -499,13 +521,53 @@ public:
             L_ERR() << "Can't get memory usage of portod" << std::endl;
         m["memory_usage_mb"] = usage / 1024 / 1024;
         m["epoll_sources"] = Statistics->EpollSources;
+        m["queued_output"] = Statistics->QueuedOutput;
+        m["output_overflows"] = Statistics->OutputOverflows;
+        m["metrics_samples"] = Statistics->MetricsSamples;
+        m["knob_fds"] = Statistics->KnobFds;
+        m["kv_journal_writes"] = Statistics->KvJournalWrites;
+        m["kv_journal_records"] = Statistics->KvJournalRecords;
+        m["kv_journal_compactions"] = Statistics->KvJournalCompactions;
+        m["kv_reclaimed_bytes"] = Statistics->KvReclaimedBytes;
+        m["restore_load_ms"] = Statistics->RestoreLoadMs;
+        m["restore_containers_ms"] = Statistics->RestoreContainersMs;
+        m["restore_volumes_ms"] = Statistics->RestoreVolumesMs;
+        m["restore_sync_skipped"] = Statistics->RestoreSyncSkipped;
+        m["spawner_tasks"] = Statistics->SpawnerTasks;
+
+        std::pair<std::string, TPoolStatistics *> pools[] = {
+            { "info", &Statistics->InfoPool },
+            { "container", &Statistics->ContainerPool },
+            { "volume", &Statistics->VolumePool },
+        };
+        for (auto &pool : pools) {
+            m[pool.first + "_queued"] = pool.second->Queued;
+            m[pool.first + "_requests"] = pool.second->Requests;
+            m[pool.first + "_wait_ms"] = pool.second->WaitMs;
+            m[pool.first + "_rejected"] = pool.second->Rejected;
+        }
 
         return m;
     }
 };
 
-void RegisterData(std::shared_ptr<TRawValueMap> m,
-                  std::shared_ptr<TContainer> c) {
+class TPortoClientsData : public TMapValue, public TContainerValue {
+public:
+    TPortoClientsData() :
+        TMapValue(HIDDEN_VALUE | SUPERUSER_DATA),
+        TContainerValue(D_PORTO_CLIENTS,
+                        "",
+                        anyState) {}
+
+    TUintMap GetDefault() const override {
+        TUintMap m;
+        TClient::GetStatistics(m);
+        return m;
+    }
+};
+
+static TValueTable *NewDataTable() {
+    auto table = new TValueTable;
     const std::vector<TAbstractValue *> data = {
         new TStateData,
         new TAbsoluteNameData,
@@ -530,8 +592,17 @@ void RegisterData(std::shared_ptr<TRawValueMap> m,
         new TTimeData,
         new TMaxRssData,
         new TPortoStatData,
+        new TPortoClientsData,
     };
 
     for (auto d : data)
-        AddContainerValue(m, c, d);
+        AddContainerValue(*table, d);
+
+    return table;
+}
+
+void RegisterData(std::shared_ptr<TRawValueMap> m,
+                  std::shared_ptr<TContainer> c) {
+    static const TValueTable *table = NewDataTable();
+    m->SetTable(*table, c);
 }
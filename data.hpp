@@ -4,6 +4,9 @@
 
 class TContainer;
 
+// Data can be read only by privileged user
+const unsigned int SUPERUSER_DATA = (1 << 0);
+
 constexpr const char *D_ABSOLUTE_NAME = "absolute_name";
 constexpr const char *D_OOM_KILLED = "oom_killed";
 constexpr const char *D_PARENT = "parent";
@@ -27,6 +30,7 @@ constexpr const char *D_IO_READ = "io_read";
 constexpr const char *D_IO_WRITE = "io_write";
 constexpr const char *D_TIME = "time";
 constexpr const char *D_PORTO_STAT = "porto_stat";
+constexpr const char *D_PORTO_CLIENTS = "porto_clients";
 
 void RegisterData(std::shared_ptr<TRawValueMap> m,
                   std::shared_ptr<TContainer> c);
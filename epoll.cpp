@@ -1,3 +1,5 @@
+#include <cstring>
+
 #include "epoll.hpp"
 #include "statistics.hpp"
 #include "config.hpp"
@@ -7,6 +9,7 @@
 extern "C" {
 #include <unistd.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 }
 
 static volatile sig_atomic_t signal_mask;
@@ -64,14 +67,34 @@ TError TEpollLoop::Create() {
         return error;
     }
 
+    WakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (WakeupFd < 0) {
+        error = TError(EError::Unknown, errno, "eventfd()");
+        Destroy();
+        return error;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &WakeupFd;
+    if (epoll_ctl(EpollFd, EPOLL_CTL_ADD, WakeupFd, &ev) < 0) {
+        error = TError(EError::Unknown, errno, "epoll_add(" + std::to_string(WakeupFd) + ")");
+        Destroy();
+        return error;
+    }
+
     return TError::Success();
 }
 
 void TEpollLoop::Destroy() {
     auto lock = ScopedLock();
     Sources.clear();
+    Pending.clear();
     close(EpollFd);
     EpollFd = -1;
+    if (WakeupFd >= 0)
+        close(WakeupFd);
+    WakeupFd = -1;
 }
 
 bool TEpollLoop::GetSignals(std::vector<int> &signals) {
@@ -116,8 +139,24 @@ TError TEpollLoop::GetEvents(std::vector<int> &signals,
 
         GetSignals(signals);
 
-        for (int i = 0; i < nr; i++)
+        for (int i = 0; i < nr; i++) {
+            if (Events[i].data.ptr == &WakeupFd) {
+                uint64_t count;
+                if (read(WakeupFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                    L_WRN() << "Can't read wakeup eventfd: " << strerror(errno) << std::endl;
+                continue;
+            }
             evts.push_back(Events[i]);
+        }
+
+        auto lock = ScopedLock();
+        for (auto ptr : Pending) {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.ptr = ptr;
+            evts.push_back(ev);
+        }
+        Pending.clear();
     }
 
     return TError::Success();
@@ -159,28 +198,38 @@ void TEpollLoop::RemoveSource(std::shared_ptr<TEpollSource> source) {
         L() << "Can't remove fd " << source->Fd << " from epoll: " << error << std::endl;
 }
 
-TError TEpollLoop::ModifySourceEvents(std::shared_ptr<TEpollSource> source, bool in) {
+TError TEpollLoop::ModifySource(TEpollSource &source, bool in, bool out) {
     auto lock = ScopedLock();
 
-    void *ptr = static_cast<void *>(source.get());
+    void *ptr = static_cast<void *>(&source);
     if (Sources.find(ptr) != Sources.end()) {
         struct epoll_event ev;
         ev.events = EPOLLHUP;
         if (in)
             ev.events |= EPOLLIN;
+        if (out)
+            ev.events |= EPOLLOUT;
         ev.data.ptr = ptr;
-        if (epoll_ctl(EpollFd, EPOLL_CTL_MOD, source->Fd, &ev) < 0)
-            return TError(EError::Unknown, errno, "epoll_mod(" + std::to_string(source->Fd) + ")");
+        if (epoll_ctl(EpollFd, EPOLL_CTL_MOD, source.Fd, &ev) < 0)
+            return TError(EError::Unknown, errno, "epoll_mod(" + std::to_string(source.Fd) + ")");
     }
     return TError::Success();
 }
 
-TError TEpollLoop::EnableSource(std::shared_ptr<TEpollSource> source) {
-    return ModifySourceEvents(source, true);
-}
+TError TEpollLoop::WakeupSource(TEpollSource &source) {
+    auto lock = ScopedLock();
 
-TError TEpollLoop::DisableSource(std::shared_ptr<TEpollSource> source) {
-    return ModifySourceEvents(source, false);
+    void *ptr = static_cast<void *>(&source);
+    if (Sources.find(ptr) == Sources.end())
+        return TError::Success();
+
+    Pending.push_back(ptr);
+
+    uint64_t one = 1;
+    if (write(WakeupFd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        return TError(EError::Unknown, errno, "write(eventfd)");
+
+    return TError::Success();
 }
 
 std::shared_ptr<TEpollSource> TEpollLoop::GetSource(void *ptr) {
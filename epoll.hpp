@@ -2,6 +2,7 @@
 
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "common.hpp"
 #include "util/signal.hpp"
@@ -47,8 +48,11 @@ class TEpollLoop : public TLockable, public TNonCopyable {
 
     std::map<void *, std::weak_ptr<TEpollSource>> Sources;
 
+    // sources with data buffered in userspace, reported as EPOLLIN
+    int WakeupFd = -1;
+    std::vector<void *> Pending;
+
     TError RemoveFd(int fd);
-    TError ModifySourceEvents(std::shared_ptr<TEpollSource> source, bool in);
 
 public:
     TError Create();
@@ -58,8 +62,8 @@ public:
     TError AddSource(std::shared_ptr<TEpollSource> source);
     void RemoveSource(std::shared_ptr<TEpollSource> source);
     std::shared_ptr<TEpollSource> GetSource(void *ptr);
-    TError EnableSource(std::shared_ptr<TEpollSource> source);
-    TError DisableSource(std::shared_ptr<TEpollSource> source);
+    TError ModifySource(TEpollSource &source, bool in, bool out);
+    TError WakeupSource(TEpollSource &source);
     TError GetEvents(std::vector<int> &signals,
                      std::vector<struct epoll_event> &evts,
                      int timeout);
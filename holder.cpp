@@ -59,7 +59,7 @@ TError TContainerHolder::CreateRoot(TScopedLock &holder_lock) {
     if (error)
         return error;
 
-    error = container->Prop->Set<bool>(P_ISOLATE, false);
+    error = container->Prop->Set(Props::Isolate, false);
     if (error)
         return error;
 
@@ -79,7 +79,7 @@ TError TContainerHolder::CreatePortoRoot(TScopedLock &holder_lock) {
     if (container->GetId() != PORTO_ROOT_CONTAINER_ID)
         return TError(EError::Unknown, "Unexpected /porto container id " + std::to_string(container->GetId()));
 
-    error = container->Prop->Set<bool>(P_ISOLATE, false);
+    error = container->Prop->Set(Props::Isolate, false);
     if (error)
         return error;
 
@@ -121,25 +121,70 @@ bool TContainerHolder::ValidName(const std::string &name) const {
                    }) == name.end();
 }
 
-std::shared_ptr<TContainer> TContainerHolder::GetParent(const std::string &name) const {
-    std::shared_ptr<TContainer> parent;
-
+// Walks name tree: "/" is the root node, "/porto" is its child
+// and top-level containers are children of "/porto"
+TNameNode *TContainerHolder::FindNode(const std::string &name, bool parent) const {
     if (name == ROOT_CONTAINER)
+        return parent ? nullptr : NameTree.get();
+
+    if (name == PORTO_ROOT_CONTAINER && parent)
+        return NameTree.get();
+
+    auto it = NameTree->Children.find(PORTO_ROOT_CONTAINER);
+    if (it == NameTree->Children.end())
         return nullptr;
-    else if (name == PORTO_ROOT_CONTAINER)
-        return Containers.at(ROOT_CONTAINER);
 
-    std::string::size_type n = name.rfind('/');
-    if (n == std::string::npos) {
-        return Containers.at(PORTO_ROOT_CONTAINER);
-    } else {
-        std::string parentName = name.substr(0, n);
+    TNameNode *node = it->second.get();
+    if (name == PORTO_ROOT_CONTAINER)
+        return node;
 
-        if (Containers.find(parentName) == Containers.end())
+    std::string component;
+    std::string::size_type begin = 0;
+
+    while (true) {
+        auto end = name.find('/', begin);
+        if (end == std::string::npos && parent)
+            return node;
+
+        component.assign(name, begin, end == std::string::npos ?
+                                      std::string::npos : end - begin);
+        auto child = node->Children.find(component);
+        if (child == node->Children.end())
             return nullptr;
 
-        return Containers.at(parentName);
+        node = child->second.get();
+        if (end == std::string::npos)
+            return node;
+        begin = end + 1;
+    }
+}
+
+std::shared_ptr<TContainer> TContainerHolder::GetParent(const std::string &name) const {
+    auto node = FindNode(name, true);
+    return node ? node->Container : nullptr;
+}
+
+void TContainerHolder::Link(std::shared_ptr<TContainer> c) {
+    const std::string &name = c->GetName();
+
+    if (name == ROOT_CONTAINER) {
+        NameTree->Container = c;
+        return;
     }
+
+    auto parent = FindNode(name, true);
+    PORTO_ASSERT(parent != nullptr);
+
+    std::string key = name;
+    auto n = name.rfind('/');
+    if (name != PORTO_ROOT_CONTAINER && n != std::string::npos)
+        key = name.substr(n + 1);
+
+    auto node = new TNameNode;
+    node->Key = key;
+    node->Parent = parent;
+    node->Container = c;
+    parent->Children[key].reset(node);
 }
 
 TError TContainerHolder::Create(TScopedLock &holder_lock, const std::string &name, const TCred &cred, std::shared_ptr<TContainer> &container) {
@@ -173,7 +218,9 @@ TError TContainerHolder::Create(TScopedLock &holder_lock, const std::string &nam
         return error;
 
     Containers[name] = c;
+    Link(c);
     Statistics->Created++;
+    PublishSnapshot();
 
     if (parent)
         parent->AddChild(c);
@@ -213,13 +260,17 @@ TError TContainerHolder::GetLocked(TScopedLock &holder_lock,
         absoluteName = name;
     }
 
-    // get container
-    TError error = Get(absoluteName, c);
+    // get container, read-only requests come without holder lock
+    TError error = holder_lock.owns_lock() ? Get(absoluteName, c) :
+                                             Find(absoluteName, c);
     if (error)
         return error;
 
     // lock container
-    l = TNestedScopedLock(*c, holder_lock);
+    if (holder_lock.owns_lock())
+        l = TNestedScopedLock(*c, holder_lock);
+    else
+        l = TNestedScopedLock(*c);
 
     // make sure it's still alive
     if (!c->IsValid())
@@ -276,19 +327,61 @@ TError TContainerHolder::Destroy(TScopedLock &holder_lock, std::shared_ptr<TCont
 }
 
 void TContainerHolder::Unlink(TScopedLock &holder_lock, std::shared_ptr<TContainer> c) {
-    for (auto name: c->GetChildren()) {
-        std::shared_ptr<TContainer> child;
-        if (Get(name, child))
-            continue;
+    auto node = FindNode(c->GetName());
+    PORTO_ASSERT(node != nullptr && node->Container == c);
+    Unlink(holder_lock, node);
+}
 
-        Unlink(holder_lock, child);
-    }
+void TContainerHolder::Unlink(TScopedLock &holder_lock, TNameNode *node) {
+    while (!node->Children.empty())
+        Unlink(holder_lock, node->Children.begin()->second.get());
 
+    auto c = node->Container;
     c->Destroy(holder_lock);
 
     IdMap.Put(c->GetId());
     Containers.erase(c->GetName());
     Statistics->Created--;
+    PublishSnapshot();
+
+    if (node->Parent)
+        node->Parent->Children.erase(node->Key);
+    else
+        node->Container = nullptr;
+}
+
+void TContainerHolder::PublishSnapshot() {
+    Snapshot.Store(std::make_shared<const TContainerMap>(Containers));
+}
+
+std::shared_ptr<const TContainerMap> TContainerHolder::GetSnapshot() const {
+    return Snapshot.Load();
+}
+
+TError TContainerHolder::Find(const std::string &name, std::shared_ptr<TContainer> &c) const {
+    auto snapshot = GetSnapshot();
+    auto it = snapshot->find(name);
+    if (it == snapshot->end())
+        return TError(EError::ContainerDoesNotExist, "container " + name + " doesn't exist");
+
+    c = it->second;
+    return TError::Success();
+}
+
+void TContainerHolder::Walk(const std::string &prefix, const std::string &after,
+        const std::function<bool(const std::shared_ptr<TContainer> &)> &fn) const {
+    auto snapshot = GetSnapshot();
+    auto it = snapshot->lower_bound(prefix);
+
+    if (after > prefix)
+        it = snapshot->upper_bound(after);
+
+    for (; it != snapshot->end(); it++) {
+        if (it->first.compare(0, prefix.length(), prefix) != 0)
+            break;
+        if (!fn(it->second))
+            break;
+    }
 }
 
 std::vector<std::shared_ptr<TContainer> > TContainerHolder::List(bool all) const {
@@ -304,6 +397,29 @@ std::vector<std::shared_ptr<TContainer> > TContainerHolder::List(bool all) const
     return ret;
 }
 
+void TContainerHolder::RegisterPid(int pid, std::shared_ptr<TContainer> c) {
+    if (pid > 0)
+        Pids[pid] = c;
+}
+
+void TContainerHolder::UnregisterPid(int pid, const TContainer *c) {
+    auto it = Pids.find(pid);
+    if (it == Pids.end())
+        return;
+
+    // pid might be already reused by task of another container
+    auto owner = it->second.lock();
+    if (!owner || owner.get() == c)
+        Pids.erase(it);
+}
+
+std::shared_ptr<TContainer> TContainerHolder::FindPid(int pid) const {
+    auto it = Pids.find(pid);
+    if (it == Pids.end())
+        return nullptr;
+    return it->second.lock();
+}
+
 TError TContainerHolder::RestoreId(const kv::TNode &node, uint16_t &id) {
     std::string value = "";
 
@@ -336,70 +452,98 @@ TError TContainerHolder::RestoreId(const kv::TNode &node, uint16_t &id) {
     return TError::Success();
 }
 
-std::map<std::string, std::shared_ptr<TKeyValueNode>> TContainerHolder::SortNodes(const std::vector<std::shared_ptr<TKeyValueNode>> &nodes) {
-    // FIXME since v1.0 we use container id as kvalue node name and because
-    // we need to create containers in particular order we create this
-    // name-sorted map
-    std::map<std::string, std::shared_ptr<TKeyValueNode>> name2node;
-
-    for (auto node : nodes) {
-        kv::TNode n;
-        TError error = node->Load(n);
-        if (error) {
-            L_ERR() << "Can't load key-value node " << node->GetPath() << ": " << error << std::endl;
-            node->Remove();
-            Statistics->RestoreFailed++;
+struct TRestoreNode {
+    std::shared_ptr<TKeyValueNode> Node;
+    kv::TNode Data;
+    std::string Name;
+    bool Legacy = false;
+    TError Error;
+};
+
+// Loads and parses every node once, nodes are copied from memory
+// of key-value storage under its lock thus threads wouldn't help
+static void LoadNodes(const std::vector<std::shared_ptr<TKeyValueNode>> &nodes,
+                      std::vector<TRestoreNode> &loaded) {
+    loaded.resize(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        auto &r = loaded[i];
+
+        r.Node = nodes[i];
+        r.Error = r.Node->Load(r.Data);
+        if (r.Error)
             continue;
-        }
-
-        std::string name;
-        if (TKeyValueStorage::Get(n, P_RAW_NAME, name))
-            name = TKeyValueStorage::FromPath(node->GetName());
 
-        name2node[name] = node;
+        // FIXME since v1.0 we use container id as kvalue node name
+        r.Legacy = !!TKeyValueStorage::Get(r.Data, P_RAW_NAME, r.Name);
+        if (r.Legacy)
+            r.Name = TKeyValueStorage::FromPath(r.Node->GetName());
     }
-
-    return name2node;
 }
 
 bool TContainerHolder::RestoreFromStorage() {
     std::vector<std::shared_ptr<TKeyValueNode>> nodes;
+    std::vector<TRestoreNode> loaded;
 
     auto holder_lock = ScopedLock();
 
+    uint64_t begin = GetCurrentTimeMs();
+
     TError error = Storage->ListNodes(nodes);
     if (error) {
         L_ERR() << "Can't list key-value nodes: " << error << std::endl;
         return false;
     }
 
-    auto name2node = SortNodes(nodes);
+    LoadNodes(nodes, loaded);
+
+    // parents go before children in name order
+    std::map<std::string, TRestoreNode *> name2node;
+    for (auto &r : loaded) {
+        if (r.Error) {
+            L_ERR() << "Can't load key-value node " << r.Node->GetPath() << ": " << r.Error << std::endl;
+            r.Node->Remove();
+            Statistics->RestoreFailed++;
+            continue;
+        }
+        name2node[r.Name] = &r;
+    }
+
+    uint64_t loadMs = GetCurrentTimeMs() - begin;
+    begin = GetCurrentTimeMs();
+
     bool restored = false;
     for (auto &pair : name2node) {
-        auto node = pair.second;
-        auto name = pair.first;
+        auto &r = *pair.second;
+        auto &name = pair.first;
 
         L_ACT() << "Found " << name << " container in kvs" << std::endl;
 
-        kv::TNode n;
-        error = node->Load(n);
-        if (error)
-            continue;
-
         restored = true;
-        error = Restore(holder_lock, name, n);
+        error = Restore(holder_lock, name, r.Data);
         if (error) {
             L_ERR() << "Can't restore " << name << ": " << error << std::endl;
             Statistics->RestoreFailed++;
-            node->Remove();
+            r.Node->Remove();
             continue;
         }
 
         // FIXME since v1.0 we need to cleanup kvalue nodes with old naming
-        if (TKeyValueStorage::Get(n, P_RAW_NAME, name))
-            node->Remove();
+        if (r.Legacy)
+            r.Node->Remove();
     }
 
+    // restored containers are published all at once
+    PublishSnapshot();
+
+    uint64_t restoreMs = GetCurrentTimeMs() - begin;
+
+    L() << "Restored " << name2node.size() << " containers: load " << loadMs
+        << " ms, restore " << restoreMs << " ms" << std::endl;
+
+    Statistics->RestoreLoadMs = loadMs;
+    Statistics->RestoreContainersMs = restoreMs;
+
     if (restored) {
         for (auto &c: Containers) {
             if (c.second->IsLostAndRestored()) {
@@ -439,6 +583,7 @@ TError TContainerHolder::Restore(TScopedLock &holder_lock, const std::string &na
     }
 
     Containers[name] = c;
+    Link(c);
     Statistics->Created++;
     return TError::Success();
 }
@@ -502,21 +647,18 @@ bool TContainerHolder::DeliverEvent(const TEvent &event) {
     }
     case EEventType::Exit:
     {
-        auto list = List();
-        for (auto &target : list) {
-            // check whether container can exit under holder lock,
-            // assume container state is not changed when only holding
-            // container lock
-            if (target->MayExit(event.Exit.Pid)) {
-                TNestedScopedLock lock(*target, holder_lock);
-                if (target->IsValid() && target->MayExit(event.Exit.Pid)) {
-                    // we don't want any concurrent stop/start/pause/etc and
-                    // don't care whether parent acquired or not
-                    target->AcquireForced();
-                    target->DeliverEvent(holder_lock, event);
-                    target->Release();
-                    break;
-                }
+        std::shared_ptr<TContainer> target = FindPid(event.Exit.Pid);
+        // check whether container can exit under holder lock,
+        // assume container state is not changed when only holding
+        // container lock
+        if (target && target->MayExit(event.Exit.Pid)) {
+            TNestedScopedLock lock(*target, holder_lock);
+            if (target->IsValid() && target->MayExit(event.Exit.Pid)) {
+                // we don't want any concurrent stop/start/pause/etc and
+                // don't care whether parent acquired or not
+                target->AcquireForced();
+                target->DeliverEvent(holder_lock, event);
+                target->Release();
             }
         }
         AckExitStatus(event.Exit.Pid);
@@ -4,6 +4,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <functional>
 
 #include "common.hpp"
 #include "util/idmap.hpp"
@@ -25,10 +26,26 @@ namespace kv {
     class TNode;
 };
 
+typedef std::map<std::string, std::shared_ptr<TContainer>> TContainerMap;
+
+// Node of container name tree, children are indexed by last name component
+struct TNameNode : public TNonCopyable {
+    std::string Key;
+    TNameNode *Parent = nullptr;
+    std::shared_ptr<TContainer> Container;
+    std::map<std::string, std::unique_ptr<TNameNode>> Children;
+};
+
 class TContainerHolder : public std::enable_shared_from_this<TContainerHolder>,
                          public TLockable {
     std::shared_ptr<TNetwork> Net;
-    std::map<std::string, std::shared_ptr<TContainer>> Containers;
+    TContainerMap Containers;
+    // same containers by hierarchy, changed under holder lock
+    std::unique_ptr<TNameNode> NameTree;
+    // immutable copy of Containers, replaced under holder lock and
+    // read without it
+    TAtomicSharedPtr<const TContainerMap> Snapshot;
+    std::map<int, std::weak_ptr<TContainer>> Pids; // changed under holder lock
     TIdMap IdMap;
     std::shared_ptr<TKeyValueStorage> Storage;
 
@@ -36,18 +53,24 @@ class TContainerHolder : public std::enable_shared_from_this<TContainerHolder>,
     void ScheduleLogRotatation();
     void ScheduleCgroupSync();
     TError ReserveDefaultClassId();
-    std::map<std::string, std::shared_ptr<TKeyValueNode>>
-        SortNodes(const std::vector<std::shared_ptr<TKeyValueNode>> &nodes);
+    TNameNode *FindNode(const std::string &name, bool parent = false) const;
+    void Link(std::shared_ptr<TContainer> c);
     void Unlink(TScopedLock &holder_lock, std::shared_ptr<TContainer> c);
+    void Unlink(TScopedLock &holder_lock, TNameNode *node);
+    void PublishSnapshot();
 
 public:
     std::shared_ptr<TEventQueue> Queue = nullptr;
     std::shared_ptr<TEpollLoop> EpollLoop;
+    // OOM eventfds handed over by previous slave, taken during restore
+    std::map<std::string, int> OomFds;
 
     TContainerHolder(std::shared_ptr<TEpollLoop> epollLoop,
                      std::shared_ptr<TNetwork> net,
                      std::shared_ptr<TKeyValueStorage> storage) :
-        Net(net), Storage(storage), EpollLoop(epollLoop) { }
+        Net(net), NameTree(new TNameNode),
+        Snapshot(std::make_shared<const TContainerMap>()),
+        Storage(storage), EpollLoop(epollLoop) { }
     bool ValidName(const std::string &name) const;
     std::shared_ptr<TContainer> GetParent(const std::string &name) const;
     TError CreateRoot(TScopedLock &holder_lock);
@@ -71,5 +94,17 @@ public:
 
     std::vector<std::shared_ptr<TContainer> > List(bool all = false) const;
 
+    // don't need holder lock
+    std::shared_ptr<const TContainerMap> GetSnapshot() const;
+    TError Find(const std::string &name, std::shared_ptr<TContainer> &c) const;
+    // Visit containers with given name prefix in name order, starting after
+    // name "after" if it isn't empty, until fn returns false
+    void Walk(const std::string &prefix, const std::string &after,
+              const std::function<bool(const std::shared_ptr<TContainer> &)> &fn) const;
+
+    void RegisterPid(int pid, std::shared_ptr<TContainer> c);
+    void UnregisterPid(int pid, const TContainer *c);
+    std::shared_ptr<TContainer> FindPid(int pid) const;
+
     bool DeliverEvent(const TEvent &event);
 };
@@ -6,6 +6,8 @@
 #include "util/file.hpp"
 #include "util/folder.hpp"
 #include "util/unix.hpp"
+#include "util/signal.hpp"
+#include "statistics.hpp"
 
 extern "C" {
 #include <sys/types.h>
@@ -38,107 +40,419 @@ std::string TKeyValueStorage::FromPath(const std::string &path) {
     return s;
 }
 
-void TKeyValueNode::Merge(kv::TNode &node, kv::TNode &next) const {
-    for (int i = 0; i < next.pairs_size(); i++) {
-        auto key = next.pairs(i).key();
-        auto value = next.pairs(i).val();
+// journal name starts with slash substitute thus never clashes with nodes
+static const std::string JOURNAL_NAME = std::string(1, SLASH_SUBST) + "journal";
 
-        bool replaced = false;
-        for (int j = 0; j < node.pairs_size(); j++)
-            if (key == node.pairs(j).key()) {
-                node.mutable_pairs(j)->set_val(value);
-                replaced = true;
-                break;
-            }
+void TKeyValueData::Reset(const kv::TNode &node) {
+    Node.reset(new kv::TNode(node));
+    Index.clear();
+    for (int i = 0; i < Node->pairs_size(); i++)
+        Index[Node->pairs(i).key()] = i;
+}
+
+void TKeyValueData::Merge(const kv::TNode &next) {
+    if (!Node)
+        Node.reset(new kv::TNode);
+
+    for (auto &pair : next.pairs()) {
+        auto it = Index.find(pair.key());
+        if (it != Index.end()) {
+            Node->mutable_pairs(it->second)->set_val(pair.val());
+        } else {
+            Index[pair.key()] = Node->pairs_size();
+            *Node->add_pairs() = pair;
+        }
+    }
+}
+
+static void AppendRecord(std::string &buf, const kv::TJournalRecord &record) {
+    google::protobuf::io::StringOutputStream stream(&buf);
+    google::protobuf::io::CodedOutputStream output(&stream);
+    output.WriteVarint32(record.ByteSizeLong());
+    record.SerializeWithCachedSizes(&output);
+}
+
+static TError WriteAll(int fd, const std::string &buf) {
+    size_t off = 0;
 
-        if (!replaced) {
-            auto pair = node.add_pairs();
-            pair->set_key(key);
-            pair->set_val(value);
+    while (off < buf.size()) {
+        ssize_t ret = write(fd, buf.data() + off, buf.size() - off);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return TError(EError::Unknown, errno, "write()");
         }
+        off += ret;
     }
+
+    return TError::Success();
 }
 
 #define __class__ (std::string(typeid(*this).name()))
 
+// FIXME remove when all users are updated to journal
+static TError LoadLegacyNode(const TPath &path, TKeyValueData &data) {
+    TScopedFd fd;
+    fd = open(path.ToString().c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd.GetFd() < 0)
+        return TError(EError::Unknown, errno, "open(" + path.ToString() + ")");
+
+    kv::TNode next;
+    google::protobuf::io::FileInputStream pist(fd.GetFd());
+    if (!ReadDelimitedFrom(&pist, &next))
+        return TError(EError::Unknown, "protobuf read error: " + path.ToString());
+
+    data.Reset(next);
+    while (ReadDelimitedFrom(&pist, &next))
+        data.Merge(next);
+
+    return TError::Success();
+}
+
 TError TKeyValueNode::Load(kv::TNode &node) const {
     auto lock = Storage->ScopedLock();
 
-    TScopedFd fd;
-    fd = open(Path.ToString().c_str(), O_RDONLY | O_CLOEXEC);
-    node.Clear();
-    TError error;
-    try {
-        google::protobuf::io::FileInputStream pist(fd.GetFd());
-        if (!ReadDelimitedFrom(&pist, &node)) {
-            error = TError(EError::Unknown, __class__ + ": protobuf read error");
-        }
-
-        kv::TNode next;
-        next.Clear();
-        while (ReadDelimitedFrom(&pist, &next))
-            Merge(node, next);
-    } catch (...) {
-        if (config().daemon().debug())
-            throw;
-        error = TError(EError::Unknown, __class__ + ": unhandled exception");
+    auto it = Storage->Nodes.find(Name);
+    if (it == Storage->Nodes.end()) {
+        node.Clear();
+        return TError(EError::Unknown, __class__ + ": node " + Name + " not found");
     }
-    return error;
+
+    node.CopyFrom(*it->second.Node);
+    return TError::Success();
 }
 
 TError TKeyValueNode::Append(const kv::TNode &node) const {
-    auto lock = Storage->ScopedLock();
+    kv::TJournalRecord record;
+    record.set_node(Name);
+    record.mutable_data()->CopyFrom(node);
 
-    TScopedFd fd;
-    fd = open(Path.ToString().c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0755);
-    TError error;
+    auto lock = Storage->ScopedLock();
 
-    if (lseek(fd.GetFd(), 0, SEEK_END) < 0) {
-        TError error(EError::Unknown, errno, __class__ + ": open(" + Path.ToString() + ")");
-        L_ERR() << "Can't append key-value node: " << error << std::endl;
-        return error;
-    }
-    try {
-        google::protobuf::io::FileOutputStream post(fd.GetFd());
-        if (!WriteDelimitedTo(node, &post))
-            error = TError(EError::Unknown, __class__ + ": protobuf write error");
-    } catch (...) {
-        if (config().daemon().debug())
-            throw;
-        error = TError(EError::Unknown, __class__ + ": unhandled exception");
-    }
+    TError error = Storage->Commit(lock, record);
     if (error)
         L_ERR() << "Can't append key-value node: " << error << std::endl;
     return error;
 }
 
 TError TKeyValueNode::Save(const kv::TNode &node) const {
+    kv::TJournalRecord record;
+    record.set_node(Name);
+    record.mutable_data()->CopyFrom(node);
+    record.set_replace(true);
+
     auto lock = Storage->ScopedLock();
 
-    TScopedFd fd;
-    fd = open(Path.ToString().c_str(), O_CREAT | O_WRONLY | O_TRUNC | O_CLOEXEC, 0755);
+    return Storage->Commit(lock, record);
+}
+
+TError TKeyValueNode::Remove() const {
+    kv::TJournalRecord record;
+    record.set_node(Name);
+    record.set_remove(true);
+
+    auto lock = Storage->ScopedLock();
+
+    if (!Storage->Nodes.count(Name))
+        return TError::Success();
+
+    return Storage->Commit(lock, record);
+}
+
+TKeyValueStorage::TKeyValueStorage(const TMount &mount, uint64_t compactRecords) :
+    Tmpfs(mount), DirnameLen((Tmpfs.GetMountpoint().ToString() + "/").length()),
+    JournalPath(Tmpfs.GetMountpoint() / JOURNAL_NAME), CompactRecords(compactRecords) {}
+
+TKeyValueStorage::~TKeyValueStorage() {
+    CloseJournal();
+}
+
+void TKeyValueStorage::Apply(const kv::TJournalRecord &record) {
+    if (record.remove())
+        Nodes.erase(record.node());
+    else if (record.replace())
+        Nodes[record.node()].Reset(record.data());
+    else
+        Nodes[record.node()].Merge(record.data());
+}
+
+// Queues record and waits until it hits the journal. Either some other
+// thread is writing right now and will pick it up with the next batch or
+// this thread becomes the writer for everything queued so far.
+TError TKeyValueStorage::Commit(TScopedLock &lock, const kv::TJournalRecord &record) {
+    if (JournalFd < 0)
+        return TError(EError::Unknown, "Key-value journal " + JournalPath.ToString() + " isn't open");
+
+    TKeyValueCommit commit;
+    commit.Record = &record;
+    Pending.push_back(&commit);
+
+    while (!commit.Done) {
+        if (Writing) {
+            Written.wait(lock);
+            continue;
+        }
+
+        std::vector<TKeyValueCommit *> batch;
+        batch.swap(Pending);
+        uint64_t offset = JournalSize;
+        Writing = true;
+
+        lock.unlock();
+        std::string buf;
+        for (auto c : batch)
+            AppendRecord(buf, *c->Record);
+        bool torn = false;
+        TError error = WriteJournal(buf, offset, torn);
+        lock.lock();
+
+        Writing = false;
+        if (torn)
+            Torn = true;
+        if (!error) {
+            JournalSize += buf.size();
+            AppendedRecords += batch.size();
+        }
+
+        // apply in journal order, failed records are dropped from memory too
+        for (auto c : batch) {
+            if (!error)
+                Apply(*c->Record);
+            c->Error = error;
+            c->Done = true;
+        }
+
+        Statistics->KvJournalWrites++;
+        Statistics->KvJournalRecords += batch.size();
+
+        Written.notify_all();
+        if (NeedCompaction())
+            CompactorCv.notify_one();
+    }
+
+    return commit.Error;
+}
+
+// Failed write might leave part of batch in journal, cut it off
+// otherwise replay stops there and ignores everything appended later.
+TError TKeyValueStorage::WriteJournal(const std::string &buf, uint64_t offset, bool &torn) {
+    TError error = WriteAll(JournalFd, buf);
+    if (error) {
+        L_ERR() << "Can't write key-value journal: " << error << std::endl;
+        if (ftruncate(JournalFd, offset)) {
+            L_ERR() << "Can't truncate key-value journal: "
+                    << TError(EError::Unknown, errno, "ftruncate()") << std::endl;
+            torn = true;
+        }
+    }
+    return error;
+}
+
+// Compact after enough appends if at least half of journal is garbage
+bool TKeyValueStorage::NeedCompaction() const {
+    return Torn || (AppendedRecords >= CompactRecords &&
+                    JournalSize > CompactedSize * 2);
+}
+
+// Rewrites journal with one record per live node, records queued
+// meanwhile stay pending and go into the new journal afterwards.
+TError TKeyValueStorage::Compact(TScopedLock &lock) {
+    while (Writing)
+        Written.wait(lock);
+
+    std::string buf;
+    for (auto &it : Nodes) {
+        kv::TJournalRecord record;
+        record.set_node(it.first);
+        record.mutable_data()->CopyFrom(*it.second.Node);
+        record.set_replace(true);
+        AppendRecord(buf, record);
+    }
+
+    Writing = true;
+
+    lock.unlock();
+
+    TPath tmpPath = Tmpfs.GetMountpoint() / (JOURNAL_NAME + ".tmp");
     TError error;
-    try {
-        google::protobuf::io::FileOutputStream post(fd.GetFd());
-        if (!WriteDelimitedTo(node, &post))
-            error = TError(EError::Unknown, __class__ + ": protobuf write error");
-    } catch (...) {
-        if (config().daemon().debug())
-            throw;
-        error = TError(EError::Unknown, __class__ + ": unhandled exception");
+    int fd = open(tmpPath.ToString().c_str(),
+                  O_CREAT | O_TRUNC | O_WRONLY | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        error = TError(EError::Unknown, errno, "open(" + tmpPath.ToString() + ")");
+    } else {
+        error = WriteAll(fd, buf);
+        if (!error && rename(tmpPath.ToString().c_str(),
+                             JournalPath.ToString().c_str()))
+            error = TError(EError::Unknown, errno, "rename(" + tmpPath.ToString() + ")");
+        if (error) {
+            close(fd);
+            (void)unlink(tmpPath.ToString().c_str());
+        }
     }
+
+    lock.lock();
+    Writing = false;
+
+    if (!error) {
+        if (JournalFd >= 0)
+            close(JournalFd);
+        JournalFd = fd;
+        if (JournalSize > buf.size())
+            Statistics->KvReclaimedBytes += JournalSize - buf.size();
+        JournalSize = CompactedSize = buf.size();
+        AppendedRecords = 0;
+        Torn = false;
+        Statistics->KvJournalCompactions++;
+    } else
+        L_ERR() << "Can't compact key-value journal: " << error << std::endl;
+
+    Written.notify_all();
     return error;
 }
 
-TError TKeyValueNode::Remove() const {
-    auto lock = Storage->ScopedLock();
+void TKeyValueStorage::CompactorFn() {
+    BlockAllSignals();
+    SetProcessName("portod-kvs");
+
+    auto lock = ScopedLock();
+    while (CompactorRunning) {
+        // after failure wait for next write before retrying
+        if (NeedCompaction() && !Compact(lock))
+            continue;
+        CompactorCv.wait(lock);
+    }
+}
+
+// Rebuilds live nodes from journal, nodes from separate files
+// which were used before journal are picked up as well.
+TError TKeyValueStorage::Replay() {
+    auto lock = ScopedLock();
+
+    Nodes.clear();
+    JournalSize = 0;
+
+    vector<string> files;
+    TFolder dir(Tmpfs.GetMountpoint());
+    TError error = dir.Items(EFileType::Regular, files);
+    if (error)
+        return error;
+
+    for (auto &name : files) {
+        if (name.compare(0, JOURNAL_NAME.length(), JOURNAL_NAME) == 0)
+            continue;
+
+        TKeyValueData data;
+        error = LoadLegacyNode(Tmpfs.GetMountpoint() / name, data);
+        if (error) {
+            L_WRN() << "Can't load key-value node " << name << ": " << error << std::endl;
+            continue;
+        }
+        Nodes[name] = std::move(data);
+    }
+
+    if (!JournalPath.Exists())
+        return TError::Success();
+
+    std::string buf;
+    error = TFile(JournalPath).AsString(buf);
+    if (error)
+        return error;
+
+    google::protobuf::io::CodedInputStream input((const uint8_t *)buf.data(), buf.size());
+
+    kv::TJournalRecord record;
+    uint64_t records = 0;
+    uint32_t size;
+    int valid = 0;
+
+    while (input.ReadVarint32(&size)) {
+        auto limit = input.PushLimit(size);
+        if (!record.ParseFromCodedStream(&input) ||
+                !input.ConsumedEntireMessage())
+            break;
+        input.PopLimit(limit);
 
-    TFile node(Path);
-    return node.Remove();
+        Apply(record);
+
+        valid = input.CurrentPosition();
+        records++;
+    }
+
+    if ((size_t)valid != buf.size())
+        L_WRN() << "Key-value journal " << JournalPath << " is truncated at "
+                << valid << " of " << buf.size() << " bytes" << std::endl;
+
+    L() << "Replayed " << records << " records of key-value journal "
+        << JournalPath << ", " << Nodes.size() << " nodes" << std::endl;
+
+    JournalSize = valid;
+    return TError::Success();
+}
+
+// Replays and compacts journal, starts background compaction.
+// Recovers whatever it can, without journal nothing could be saved.
+TError TKeyValueStorage::OpenJournal() {
+    TError replayError = Replay();
+    if (replayError)
+        L_ERR() << "Can't replay key-value journal: " << replayError << std::endl;
+
+    auto lock = ScopedLock();
+
+    TError error = Compact(lock);
+    if (error) {
+        // keep appending to current journal, compactor retries after next write
+        int fd = open(JournalPath.ToString().c_str(),
+                      O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0600);
+        if (fd < 0)
+            return TError(EError::Unknown, errno, "open(" + JournalPath.ToString() + ")");
+
+        // drop torn tail, otherwise records appended after it are lost
+        struct stat st;
+        if ((replayError || ftruncate(fd, JournalSize)) && !fstat(fd, &st))
+            JournalSize = st.st_size;
+
+        if (JournalFd >= 0)
+            close(JournalFd);
+        JournalFd = fd;
+        Torn = true;
+    } else {
+        vector<string> files;
+        TFolder dir(Tmpfs.GetMountpoint());
+        error = dir.Items(EFileType::Regular, files);
+        if (!error) {
+            for (auto &name : files)
+                if (name.compare(0, JOURNAL_NAME.length(), JOURNAL_NAME) != 0)
+                    (void)TFile(Tmpfs.GetMountpoint() / name).Remove();
+        }
+    }
+
+    if (!CompactorRunning) {
+        CompactorRunning = true;
+        Compactor = std::thread(&TKeyValueStorage::CompactorFn, this);
+    }
+
+    return TError::Success();
 }
 
-TKeyValueStorage::TKeyValueStorage(const TMount &mount) :
-    Tmpfs(mount), DirnameLen((Tmpfs.GetMountpoint().ToString() + "/").length()) {}
+void TKeyValueStorage::CloseJournal() {
+    auto lock = ScopedLock();
+
+    if (CompactorRunning) {
+        CompactorRunning = false;
+        CompactorCv.notify_all();
+        lock.unlock();
+        Compactor.join();
+        lock.lock();
+    }
+
+    while (Writing)
+        Written.wait(lock);
+
+    if (JournalFd >= 0) {
+        close(JournalFd);
+        JournalFd = -1;
+    }
+}
 
 TError TKeyValueStorage::MountTmpfs() {
     vector<shared_ptr<TMount>> mounts;
@@ -190,14 +504,10 @@ std::shared_ptr<TKeyValueNode> TKeyValueStorage::GetNode(uint16_t id) {
 }
 
 TError TKeyValueStorage::ListNodes(std::vector<std::shared_ptr<TKeyValueNode>> &list) {
-    vector<string> tmp;
-    TFolder f(Tmpfs.GetMountpoint());
-    TError error = f.Items(EFileType::Regular, tmp);
-    if (error)
-        return error;
+    auto lock = ScopedLock();
 
-    for (auto s : tmp)
-        list.push_back(GetNode(Tmpfs.GetMountpoint() / s));
+    for (auto &it : Nodes)
+        list.push_back(GetNode(Tmpfs.GetMountpoint() / it.first));
 
     return TError::Success();
 }
@@ -205,7 +515,13 @@ TError TKeyValueStorage::ListNodes(std::vector<std::shared_ptr<TKeyValueNode>> &
 TError TKeyValueStorage::Dump() {
     std::vector<std::shared_ptr<TKeyValueNode>> nodes;
 
-    TError error = ListNodes(nodes);
+    TError error = Replay();
+    if (error) {
+        L_ERR() << "Can't replay journal: " << error.GetMsg() << std::endl;
+        return error;
+    }
+
+    error = ListNodes(nodes);
     if (error) {
         L_ERR() << "Can't list nodes: " << error.GetMsg() << std::endl;
         return error;
@@ -236,6 +552,7 @@ TError TKeyValueStorage::Dump() {
 }
 
 TError TKeyValueStorage::Destroy() {
+    CloseJournal();
     return Tmpfs.Umount();
 }
 
@@ -273,3 +590,21 @@ TError TKeyValueStorage::Get(const kv::TNode &node, const std::string &name, std
 
     return TError(EError::Unknown, "Entry " + name + " not found");
 }
+
+// Compares nodes as sets of pairs, order doesn't matter
+bool TKeyValueStorage::Equal(const kv::TNode &a, const kv::TNode &b) {
+    if (a.pairs_size() != b.pairs_size())
+        return false;
+
+    std::unordered_map<std::string, const std::string *> pairs;
+    for (auto &pair : a.pairs())
+        pairs[pair.key()] = &pair.val();
+
+    for (auto &pair : b.pairs()) {
+        auto it = pairs.find(pair.key());
+        if (it == pairs.end() || *it->second != pair.val())
+            return false;
+    }
+
+    return pairs.size() == (size_t)b.pairs_size();
+}
@@ -2,7 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include "common.hpp"
 #include "util/mount.hpp"
@@ -12,6 +17,7 @@ class TKeyValueStorage;
 
 namespace kv {
     class TNode;
+    class TJournalRecord;
 };
 
 class TKeyValueNode : public TNonCopyable {
@@ -19,8 +25,6 @@ class TKeyValueNode : public TNonCopyable {
     const TPath Path;
     const std::string Name;
 
-    void Merge(kv::TNode &node, kv::TNode &next) const;
-
 public:
     TKeyValueNode(std::shared_ptr<TKeyValueStorage> storage,
                   const TPath &path, const std::string &name) :
@@ -36,17 +40,70 @@ public:
     const std::string &GetName() const { return Name; }
 };
 
+// Node kept in memory, pairs are indexed by key to merge appended ones
+struct TKeyValueData {
+    std::unique_ptr<kv::TNode> Node;
+    std::unordered_map<std::string, int> Index;
+
+    void Reset(const kv::TNode &node);
+    void Merge(const kv::TNode &next);
+};
+
+// Record waiting for group commit, writer reports result to its owner
+struct TKeyValueCommit {
+    const kv::TJournalRecord *Record;
+    TError Error;
+    bool Done = false;
+};
+
+// All nodes share one append-only journal, live nodes are kept in memory.
+// Concurrent writers are coalesced: whoever comes first writes records
+// of everybody who queued them meanwhile with a single write().
+// Records are applied to memory only after they hit the journal.
 class TKeyValueStorage : public std::enable_shared_from_this<TKeyValueStorage>,
                          public TLockable, public TNonCopyable {
+    friend class TKeyValueNode;
+
     const TMount Tmpfs;
     const size_t DirnameLen;
+    const TPath JournalPath;
+    const uint64_t CompactRecords;
+
+    std::map<std::string, TKeyValueData> Nodes;
+
+    int JournalFd = -1;
+    uint64_t JournalSize = 0;
+    uint64_t CompactedSize = 0;
+    uint64_t AppendedRecords = 0;
+
+    std::vector<TKeyValueCommit *> Pending;
+    bool Writing = false;
+    // failed write left garbage in journal, rewrite it from memory
+    bool Torn = false;
+    std::condition_variable Written;
+
+    std::thread Compactor;
+    std::condition_variable CompactorCv;
+    bool CompactorRunning = false;
 
     TPath ToPath(const std::string &name) const;
 
+    TError Commit(TScopedLock &lock, const kv::TJournalRecord &record);
+    void Apply(const kv::TJournalRecord &record);
+    TError WriteJournal(const std::string &buf, uint64_t offset, bool &torn);
+    TError Compact(TScopedLock &lock);
+    bool NeedCompaction() const;
+    void CompactorFn();
+
 public:
     TError MountTmpfs();
 
-    TKeyValueStorage(const TMount &mount);
+    TKeyValueStorage(const TMount &mount, uint64_t compactRecords);
+    ~TKeyValueStorage();
+
+    TError Replay();
+    TError OpenJournal();
+    void CloseJournal();
 
     std::shared_ptr<TKeyValueNode> GetNode(const TPath &path);
     std::shared_ptr<TKeyValueNode> GetNode(uint16_t id);
@@ -56,5 +113,6 @@ public:
     std::string GetRoot() const { return Tmpfs.GetMountpoint().ToString() + "/"; }
 
     static TError Get(const kv::TNode &node, const std::string &name, std::string &val);
+    static bool Equal(const kv::TNode &a, const kv::TNode &b);
     static std::string FromPath(const std::string &path);
 };
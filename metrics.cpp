@@ -0,0 +1,123 @@
+#include "metrics.hpp"
+#include "statistics.hpp"
+#include "holder.hpp"
+#include "container.hpp"
+#include "subsystem.hpp"
+#include "cgroup.hpp"
+#include "qdisc.hpp"
+#include "config.hpp"
+#include "util/log.hpp"
+#include "util/signal.hpp"
+#include "util/unix.hpp"
+
+static __thread uint64_t AcceptedStalenessMs;
+
+TMetricsStalenessScope::TMetricsStalenessScope(uint64_t maxStalenessMs) :
+    Prev(AcceptedStalenessMs) {
+    AcceptedStalenessMs = maxStalenessMs;
+}
+
+TMetricsStalenessScope::~TMetricsStalenessScope() {
+    AcceptedStalenessMs = Prev;
+}
+
+uint64_t TMetricsStalenessScope::MaxStalenessMs() {
+    return AcceptedStalenessMs;
+}
+
+TMetricsSampler::~TMetricsSampler() {
+    Stop();
+}
+
+void TMetricsSampler::Start() {
+    auto lock = ScopedLock();
+    if (Valid)
+        return;
+    Valid = true;
+    Thread = std::thread(&TMetricsSampler::SamplerFn, this);
+}
+
+void TMetricsSampler::Stop() {
+    {
+        auto lock = ScopedLock();
+        if (!Valid)
+            return;
+        Valid = false;
+        Cv.notify_all();
+    }
+    Thread.join();
+}
+
+void TMetricsSampler::Sample() {
+    bool network = config().network().enabled();
+
+    for (auto &it : *Holder->GetSnapshot()) {
+        auto container = it.second;
+        std::shared_ptr<TCgroup> cpuacct, memory, blkio;
+        auto metrics = std::make_shared<TContainerMetrics>();
+
+        {
+            // never wait for busy containers, they'll be sampled next time
+            auto lock = container->TryScopedLock();
+            if (!lock || !container->IsValid() || container->IsAcquired())
+                continue;
+
+            auto state = container->GetState();
+            if (state == EContainerState::Stopped ||
+                state == EContainerState::Unknown)
+                continue;
+
+            cpuacct = container->GetLeafCgroup(cpuacctSubsystem);
+            memory = container->GetLeafCgroup(memorySubsystem);
+            blkio = container->GetLeafCgroup(blkioSubsystem);
+
+            if (network)
+                metrics->HaveNet = !container->GetStat(ETclassStat::Bytes,
+                                                       metrics->NetBytes);
+        }
+
+        // these knobs are kept open by TCgroup and re-read with pread()
+        TError error = cpuacctSubsystem->Usage(cpuacct, metrics->CpuUsage);
+        if (error)
+            continue;
+
+        error = memorySubsystem->Usage(memory, metrics->MemoryUsage);
+        if (error)
+            continue;
+
+        std::vector<BlkioStat> stat;
+        error = blkioSubsystem->Statistics(blkio, "blkio.io_service_bytes_recursive", stat);
+        if (error)
+            continue;
+
+        for (auto &s : stat) {
+            metrics->IoRead[s.Device] = s.Read;
+            metrics->IoWrite[s.Device] = s.Write;
+        }
+
+        metrics->SampleMs = GetCurrentTimeMs();
+        container->SetMetrics(metrics);
+        Statistics->MetricsSamples++;
+    }
+}
+
+void TMetricsSampler::SamplerFn() {
+    BlockAllSignals();
+    SetProcessName("portod-metrics");
+
+    auto lock = ScopedLock();
+    while (Valid) {
+        lock.unlock();
+        uint64_t begin = GetCurrentTimeMs();
+        Sample();
+        uint64_t spent = GetCurrentTimeMs() - begin;
+        lock.lock();
+
+        if (spent > PeriodMs)
+            L_WRN() << "Metrics sampling took " << spent << " ms" << std::endl;
+
+        if (Valid)
+            Cv.wait_for(lock, std::chrono::milliseconds(
+                        PeriodMs > spent ? PeriodMs - spent : 0));
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+
+#include "common.hpp"
+#include "util/locks.hpp"
+
+class TContainerHolder;
+
+// Cheap counters of one container, collected by TMetricsSampler
+struct TContainerMetrics {
+    uint64_t SampleMs = 0;
+    uint64_t CpuUsage = 0;
+    uint64_t MemoryUsage = 0;
+    std::map<std::string, uint64_t> IoRead;
+    std::map<std::string, uint64_t> IoWrite;
+    std::map<std::string, uint64_t> NetBytes;
+    bool HaveNet = false;
+};
+
+// Allows data values computed in this thread to be served from
+// sampled metrics which are not older than given number of ms
+class TMetricsStalenessScope : public TNonCopyable {
+    uint64_t Prev;
+public:
+    TMetricsStalenessScope(uint64_t maxStalenessMs);
+    ~TMetricsStalenessScope();
+
+    static uint64_t MaxStalenessMs();
+};
+
+class TMetricsSampler : public TLockable, public TNonCopyable {
+    std::shared_ptr<TContainerHolder> Holder;
+    std::condition_variable Cv;
+    std::thread Thread;
+    bool Valid = false;
+    const uint64_t PeriodMs;
+
+    void Sample();
+    void SamplerFn();
+public:
+    TMetricsSampler(std::shared_ptr<TContainerHolder> holder, uint64_t periodMs) :
+        Holder(holder), PeriodMs(periodMs) {}
+    ~TMetricsSampler();
+
+    void Start();
+    void Stop();
+};
@@ -1,6 +1,9 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <map>
+#include <queue>
+#include <deque>
 #include <csignal>
 
 #include "portod.hpp"
@@ -8,6 +11,7 @@
 #include "statistics.hpp"
 #include "rpc.hpp"
 #include "holder.hpp"
+#include "container.hpp"
 #include "cgroup.hpp"
 #include "config.hpp"
 #include "event.hpp"
@@ -16,6 +20,8 @@
 #include "client.hpp"
 #include "epoll.hpp"
 #include "volume.hpp"
+#include "metrics.hpp"
+#include "task.hpp"
 #include "util/log.hpp"
 #include "util/file.hpp"
 #include "util/folder.hpp"
@@ -53,6 +59,13 @@ static bool stdlog = false;
 static bool failsafe = false;
 static bool noNetwork = false;
 
+// RPC socket and idle clients passed from previous slave on update,
+// first one is the listening socket
+static std::vector<int> upgradeFds;
+// OOM eventfds of containers passed from previous slave, by container name
+static std::map<std::string, int> upgradeOomFds;
+static bool rpcHandedOver = false;
+
 static void AllocStatistics() {
     Statistics = (TStatistics *)mmap(nullptr, sizeof(*Statistics),
                                      PROT_READ | PROT_WRITE,
@@ -132,46 +145,177 @@ struct TRequest {
     TContext *Context;
     std::shared_ptr<TClient> Client;
     rpc::TContainerRequest Request;
+    uint64_t QueuedMs;
 };
 
-class TRpcWorker : public TWorker<TRequest> {
+// Round-robin between clients, so one client flooding requests
+// doesn't delay others
+class TRpcQueue {
+    // keyed by client pid: extra connections don't buy extra share
+    std::map<pid_t, std::queue<TRequest>> Queues;
+    std::deque<pid_t> Order;
+
 public:
-    TRpcWorker(const size_t nr) : TWorker("portod-worker", nr) {}
+    bool empty() const {
+        return Order.empty();
+    }
+
+    TRequest &front() {
+        return Queues.at(Order.front()).front();
+    }
+
+    void push(TRequest &&request) {
+        pid_t pid = request.Client->GetPid();
+        auto &queue = Queues[pid];
+        if (queue.empty())
+            Order.push_back(pid);
+        queue.push(std::move(request));
+    }
+
+    void pop() {
+        pid_t pid = Order.front();
+        Order.pop_front();
+
+        auto it = Queues.find(pid);
+        it->second.pop();
+        if (it->second.empty())
+            Queues.erase(it);
+        else
+            Order.push_back(pid);
+    }
+};
+
+class TRpcWorker : public TWorker<TRequest, TRpcQueue> {
+    TPoolStatistics &Stat;
+    const size_t MaxQueued;
+public:
+    TRpcWorker(const std::string &name, const size_t nr, TPoolStatistics &stat,
+               const size_t maxQueued) :
+        TWorker(name, nr), Stat(stat), MaxQueued(maxQueued) {
+        Stat.Queued = 0;
+    }
+
+    // only epoll thread queues requests, so check and push don't race
+    bool PushRequest(TRequest &request) {
+        if (MaxQueued && Stat.Queued >= MaxQueued) {
+            Stat.Rejected++;
+            return false;
+        }
+
+        request.QueuedMs = GetCurrentTimeMs();
+        request.Client->RequestsQueued++;
+        Stat.Queued++;
+        Push(std::move(request));
+        return true;
+    }
 
     const TRequest &Top() override {
         return Queue.front();
     }
 
+    TRequest Pop() override {
+        TRequest request = std::move(Queue.front());
+        Queue.pop();
+        return request;
+    }
+
     bool Handle(const TRequest &request) override {
+        request.Client->RequestsQueued--;
+        Stat.Queued--;
+        Stat.Requests++;
+        Stat.WaitMs += GetCurrentTimeMs() - request.QueuedMs;
+
         HandleRpcRequest(*request.Context, request.Request, request.Client);
 
         return true;
     }
 };
 
-static bool QueueRequest(TContext &context,
-                         std::shared_ptr<TEpollSource> source,
-                         TRpcWorker &worker, std::shared_ptr<TClient> client) {
-    TRequest req{&context, client};
-    bool hangup = false;
-    bool fullMessage = client->ReadRequest(req.Request, hangup);
+// slow requests shouldn't delay fast ones
+struct TRpcWorkers {
+    TRpcWorker Info;
+    TRpcWorker Container;
+    TRpcWorker Volume;
+
+    TRpcWorkers() :
+        Info("portod-info", config().daemon().info_workers(),
+             Statistics->InfoPool, config().daemon().max_info_queue()),
+        Container("portod-worker", config().daemon().workers(),
+                  Statistics->ContainerPool, config().daemon().max_container_queue()),
+        Volume("portod-volume", config().daemon().volume_workers(),
+               Statistics->VolumePool, config().daemon().max_volume_queue()) {}
+
+    TRpcWorker &Select(const rpc::TContainerRequest &req) {
+        switch (ClassifyRequest(req)) {
+        case ERequestClass::Info:
+            return Info;
+        case ERequestClass::Volume:
+            return Volume;
+        default:
+            return Container;
+        }
+    }
 
-    if (hangup)
-        return true;
+    void Start() {
+        Info.Start();
+        Container.Start();
+        Volume.Start();
+    }
 
-    if (!fullMessage)
-        return false;
+    void Stop() {
+        Info.Stop();
+        Container.Stop();
+        Volume.Stop();
+    }
+};
 
-    if (client->Identify(*context.Cholder, false))
-        return true;
+static bool QueueRequest(TContext &context, TRpcWorkers &workers,
+                         std::shared_ptr<TClient> client) {
+    // one read might bring several requests
+    do {
+        // wakeup and socket events might be reported together
+        if (!client->CanRead())
+            return false;
 
-    TError error = context.EpollLoop->DisableSource(source);
-    if (error) {
-        L_WRN() << "Can't disable client " << client->GetFd() << ": " << error << std::endl;
-        return true;
-    }
+        TRequest req{&context, client};
+        bool hangup = false;
+        bool fullMessage = client->ReadRequest(req.Request, hangup);
+
+        if (hangup)
+            return true;
+
+        if (!fullMessage)
+            return false;
+
+        if (client->Identify(*context.Cholder, false))
+            return true;
+
+        // requests with id may be pipelined, keep reading until the limit,
+        // otherwise wait until reply is sent
+        bool more;
+        TError error = client->QueueRequest(req.Request.has_id(), more);
+        if (error) {
+            L_WRN() << "Can't disable client " << client->GetFd() << ": " << error << std::endl;
+            return true;
+        }
+
+        // throttled requests don't occupy workers and queues
+        if (!client->ConsumeToken()) {
+            RejectRpcRequest(req.Request, client,
+                             TError(EError::ResourceNotAvailable, "Request rate limit exceeded"));
+            continue;
+        }
 
-    worker.Push(req);
+        // bounded pools don't let backlog grow without limit
+        if (!workers.Select(req.Request).PushRequest(req)) {
+            RejectRpcRequest(req.Request, client,
+                             TError(EError::ResourceNotAvailable, "Too many queued requests"));
+            continue;
+        }
+
+        if (!more)
+            return false;
+    } while (client->BufferedRequest());
 
     return false;
 }
@@ -193,17 +337,6 @@ static int AcceptClient(TContext &context, int sfd,
         return -1;
     }
 
-    if (!config().daemon().blocking_write()) {
-        struct timeval to;
-        to.tv_sec = 30;
-        to.tv_usec = 0;
-
-        if (setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, (void *)&to, sizeof(to)) < 0) {
-            L_ERR() << "setsockopt() error: " << strerror(errno) << std::endl;
-            return -1;
-        }
-    }
-
     auto client = std::make_shared<TClient>(context.EpollLoop, cfd);
     TError error = client->Identify(*context.Cholder);
     if (error)
@@ -280,17 +413,95 @@ static inline int EncodeSignal(int sig) {
     return -sig;
 }
 
-static void StartWorkers(TContext &context, TRpcWorker &worker) {
-    worker.Start();
+static void StartWorkers(TContext &context, TRpcWorkers &workers) {
+    workers.Start();
     context.Queue->Start();
 }
 
-static void StopWorkers(TContext &context, TRpcWorker &worker) {
+static void StopWorkers(TContext &context, TRpcWorkers &workers) {
     context.Queue->Stop();
-    worker.Stop();
+    workers.Stop();
+}
+
+// Master drains socket while it waits for our exit, so when socket is full
+// wait a bit for room; give up if nobody reads it
+static TError HandOverFds(const std::string &data, const std::vector<int> &fds) {
+    TError error = SendMessage(UPGRADE_FD, data, fds, false);
+
+    while (error && error.GetErrno() == EAGAIN) {
+        struct pollfd pfd = { UPGRADE_FD, POLLOUT, 0 };
+        if (poll(&pfd, 1, 5000) <= 0)
+            break;
+        error = SendMessage(UPGRADE_FD, data, fds, false);
+    }
+
+    return error;
 }
 
-static int SlaveRpc(TContext &context, TRpcWorker &worker) {
+// Passes RPC socket and idle clients to master which keeps them for new
+// slave, thus clients don't see disconnect and connect() waits in backlog.
+// OOM eventfds go in batches too, payload lists container names in order.
+static void HandOverRpc(TContext &context, int sfd,
+                        std::map<int, std::shared_ptr<TClient>> &clients) {
+    const size_t batch = 64;
+    std::vector<int> fds;
+
+    TError error = HandOverFds(std::string(1, '\0'), { sfd });
+    if (error) {
+        L_WRN() << "Can't hand over RPC socket: " << error << std::endl;
+        return;
+    }
+    rpcHandedOver = true;
+
+    auto holder_lock = context.Cholder->ScopedLock();
+    size_t passed = 0;
+
+    for (auto it = clients.begin(); it != clients.end(); it++) {
+        if (it->second->IsIdle())
+            fds.push_back(it->first);
+
+        if (fds.size() == batch || (fds.size() && std::next(it) == clients.end())) {
+            error = HandOverFds(std::string(1, '\0'), fds);
+            if (error) {
+                L_WRN() << "Can't hand over clients: " << error << std::endl;
+                break;
+            }
+            passed += fds.size();
+            fds.clear();
+        }
+    }
+
+    L_SYS() << "Handed over RPC socket and " << passed << " of "
+            << clients.size() << " clients" << std::endl;
+
+    auto list = context.Cholder->List();
+    std::string names;
+
+    passed = 0;
+    fds.clear();
+
+    for (auto it = list.begin(); it != list.end(); it++) {
+        if ((*it)->GetOomFd() >= 0) {
+            names += (*it)->GetName() + "\n";
+            fds.push_back((*it)->GetOomFd());
+        }
+
+        if (fds.size() == batch || (fds.size() && std::next(it) == list.end())) {
+            error = HandOverFds(names, fds);
+            if (error) {
+                L_WRN() << "Can't hand over OOM eventfds: " << error << std::endl;
+                break;
+            }
+            passed += fds.size();
+            names.clear();
+            fds.clear();
+        }
+    }
+
+    L_SYS() << "Handed over " << passed << " OOM eventfds" << std::endl;
+}
+
+static int SlaveRpc(TContext &context, TRpcWorkers &workers) {
     int ret = 0;
     int sfd;
     std::map<int, std::shared_ptr<TClient>> clients;
@@ -306,12 +517,18 @@ static int SlaveRpc(TContext &context, TRpcWorker &worker) {
     if (!error)
         cred.Gid = g.GetId();
 
-    error = CreateRpcServer(config().rpc_sock().file().path(),
-                            config().rpc_sock().file().perm(),
-                            cred, sfd);
-    if (error) {
-        L_ERR() << "Can't create RPC server: " << error.GetMsg() << std::endl;
-        return EXIT_FAILURE;
+    if (upgradeFds.size()) {
+        sfd = upgradeFds[0];
+        L_SYS() << "Got RPC socket and " << upgradeFds.size() - 1
+                << " clients from previous slave" << std::endl;
+    } else {
+        error = CreateRpcServer(config().rpc_sock().file().path(),
+                                config().rpc_sock().file().perm(),
+                                cred, sfd);
+        if (error) {
+            L_ERR() << "Can't create RPC server: " << error.GetMsg() << std::endl;
+            return EXIT_FAILURE;
+        }
     }
 
     auto AcceptSource = std::make_shared<TEpollSource>(context.EpollLoop, sfd);
@@ -321,6 +538,23 @@ static int SlaveRpc(TContext &context, TRpcWorker &worker) {
         return EXIT_FAILURE;
     }
 
+    for (size_t i = 1; i < upgradeFds.size(); i++) {
+        int cfd = upgradeFds[i];
+        auto client = std::make_shared<TClient>(context.EpollLoop, cfd);
+
+        if (client->Identify(*context.Cholder))
+            continue;
+
+        error = context.EpollLoop->AddSource(client);
+        if (error) {
+            L_WRN() << "Can't add client fd to epoll: " << error << std::endl;
+            continue;
+        }
+
+        clients[cfd] = client;
+    }
+    upgradeFds.clear();
+
     auto MasterSource = std::make_shared<TEpollSource>(context.EpollLoop, REAP_EVT_FD);
     error = context.EpollLoop->AddSource(MasterSource);
     if (error && !failsafe) {
@@ -342,9 +576,17 @@ static int SlaveRpc(TContext &context, TRpcWorker &worker) {
     std::vector<int> signals;
     std::vector<struct epoll_event> events;
 
-    StartWorkers(context, worker);
+    StartWorkers(context, workers);
+
+    std::unique_ptr<TMetricsSampler> sampler;
+    if (config().daemon().metrics_sample_ms()) {
+        sampler.reset(new TMetricsSampler(context.Cholder,
+                                          config().daemon().metrics_sample_ms()));
+        sampler->Start();
+    }
 
     bool discardState = false;
+    bool upgrade = false;
     while (true) {
         if (accept_paused && clients.size() * 4 / 3 < config().daemon().max_clients()) {
             L_WRN() << "Resume accepting connections" << std::endl;
@@ -374,6 +616,7 @@ static int SlaveRpc(TContext &context, TRpcWorker &worker) {
                 goto exit;
             case updateSignal:
                 L_EVT() << "Updating" << std::endl;
+                upgrade = true;
                 ret = EncodeSignal(s);
                 goto exit;
             case rotateSignal:
@@ -451,8 +694,11 @@ static int SlaveRpc(TContext &context, TRpcWorker &worker) {
                 auto client = clients[source->Fd];
                 bool needClose = false;
 
-                if (ev.events & EPOLLIN)
-                    needClose = QueueRequest(context, source, worker, client);
+                if (ev.events & EPOLLOUT)
+                    needClose = !client->FlushOutput();
+
+                if ((ev.events & EPOLLIN) && !needClose)
+                    needClose = QueueRequest(context, workers, client);
 
                 if ((ev.events & EPOLLHUP) || needClose) {
                     context.EpollLoop->RemoveSource(source);
@@ -466,7 +712,12 @@ static int SlaveRpc(TContext &context, TRpcWorker &worker) {
     }
 
 exit:
-    StopWorkers(context, worker);
+    if (sampler)
+        sampler->Stop();
+    StopWorkers(context, workers);
+
+    if (upgrade)
+        HandOverRpc(context, sfd, clients);
 
     for (auto pair : clients)
         close(pair.first);
@@ -482,14 +733,16 @@ exit:
 static void KvDump() {
     TLogger::OpenLog(true, "", 0);
 
-    auto containers = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().keyval().file().path(), "tmpfs", { config().keyval().size() }));
+    auto containers = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().keyval().file().path(), "tmpfs", { config().keyval().size() }),
+                                                         config().keyval().compact_records());
     TError error = containers->MountTmpfs();
     if (error)
         L_ERR() << "Can't mount containers key-value storage: " << error << std::endl;
     else
         containers->Dump();
 
-    auto volumes = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().volumes().keyval().file().path(), "tmpfs", { config().volumes().keyval().size() }));
+    auto volumes = std::make_shared<TKeyValueStorage>(TMount("tmpfs", config().volumes().keyval().file().path(), "tmpfs", { config().volumes().keyval().size() }),
+                                                      config().volumes().keyval().compact_records());
     error = volumes->MountTmpfs();
     if (error)
         L_ERR() << "Can't mount volumes key-value storage: " << error << std::endl;
@@ -501,8 +754,9 @@ static int TuneLimits() {
     struct rlimit rlim;
 
     // we need two FDs for each container (to monitor OOM event and
-    // to write journal), plus some spare ones
-    int maxFd = config().container().max_total() * 2 + 100;
+    // to write journal), cached cgroup knobs, plus some spare ones
+    int maxFd = config().container().max_total() * 2 +
+                config().daemon().max_knob_fds() + 100;
 
     rlim.rlim_max = maxFd;
     rlim.rlim_cur = maxFd;
@@ -553,7 +807,7 @@ static int SlaveMain() {
     if (ret)
         return ret;
 
-    TRpcWorker worker(config().daemon().workers());
+    TRpcWorkers workers;
 
     ret = TuneLimits();
     if (ret) {
@@ -573,12 +827,30 @@ static int SlaveMain() {
             return EXIT_FAILURE;
     }
 
+    if (fcntl(UPGRADE_FD, F_SETFD, FD_CLOEXEC) < 0) {
+        L_ERR() << "Can't set close-on-exec flag on UPGRADE_FD: " << strerror(errno) << std::endl;
+        if (!failsafe)
+            return EXIT_FAILURE;
+    }
+
+    for (auto fd : upgradeFds)
+        (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+    for (auto &it : upgradeOomFds)
+        (void)fcntl(it.second, F_SETFD, FD_CLOEXEC);
+
     umask(0);
 
     TError error = SetOomScoreAdj(0);
     if (error)
         L_ERR() << "Can't adjust OOM score: " << error << std::endl;
 
+    // fork it while slave is still small and has no threads
+    if (config().daemon().task_spawner()) {
+        error = TaskSpawner.Start();
+        if (error)
+            L_ERR() << "Can't start task spawner: " << error << std::endl;
+    }
+
     TContext context;
     try {
         TCgroupSnapshot cs;
@@ -592,8 +864,18 @@ static int SlaveMain() {
             return EXIT_FAILURE;
         }
 
+        context.Cholder->OomFds.swap(upgradeOomFds);
         bool restored = context.Cholder->RestoreFromStorage();
+
+        // containers which weren't restored
+        for (auto &it : context.Cholder->OomFds)
+            close(it.second);
+        context.Cholder->OomFds.clear();
+
+        uint64_t volumesBegin = GetCurrentTimeMs();
         context.Vholder->RestoreFromStorage(context.Cholder);
+        Statistics->RestoreVolumesMs = GetCurrentTimeMs() - volumesBegin;
+        L() << "Restored volumes in " << Statistics->RestoreVolumesMs << " ms" << std::endl;
 
         L() << "Remove cgroup leftovers..." << std::endl;
 
@@ -610,10 +892,13 @@ static int SlaveMain() {
                      });
         }
 
-        ret = SlaveRpc(context, worker);
+        EncodeStaticResponses(context);
+
+        ret = SlaveRpc(context, workers);
         L_SYS() << "Shutting down..." << std::endl;
 
-        RemoveRpcServer(config().rpc_sock().file().path());
+        if (!rpcHandedOver)
+            RemoveRpcServer(config().rpc_sock().file().path());
     } catch (string s) {
         if (config().daemon().debug())
             throw;
@@ -719,9 +1004,133 @@ static int ReceiveAcks(int fd, std::map<int,int> &exited) {
     return nr;
 }
 
+static void CloseUpgradeFds() {
+    for (auto fd : upgradeFds)
+        close(fd);
+    upgradeFds.clear();
+
+    for (auto &it : upgradeOomFds)
+        close(it.second);
+    upgradeOomFds.clear();
+}
+
+// Versions which don't know about handed over fds would find RPC socket
+// alive and leak inherited fds into containers
+static bool UpgradeFdsSupported() {
+    int status;
+    TError error = Run({ program_invocation_name, "--upgrade-fds" }, status);
+    return !error && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+// Takes fds which are already queued in socket, doesn't wait for more.
+// RPC fds come with single zero byte, OOM eventfds with container names.
+static void DrainUpgradeFds(int sock) {
+    std::string data;
+    std::vector<int> fds;
+
+    while (!RecvMessage(sock, data, 65536, fds, false)) {
+        std::vector<std::string> names;
+
+        if (data == std::string(1, '\0')) {
+            upgradeFds.insert(upgradeFds.end(), fds.begin(), fds.end());
+            fds.clear();
+        } else if (!SplitString(data, '\n', names) && names.size() == fds.size()) {
+            for (size_t i = 0; i < names.size(); i++) {
+                if (!upgradeOomFds.count(names[i]))
+                    upgradeOomFds[names[i]] = fds[i];
+                else
+                    close(fds[i]);
+            }
+            fds.clear();
+        }
+
+        for (auto fd : fds)
+            close(fd);
+        fds.clear();
+    }
+
+    for (auto fd : fds)
+        close(fd);
+}
+
+// Environment string is limited by MAX_ARG_STRLEN, split long list
+static void SetUpgradeEnv(const std::string &name, const std::vector<std::string> &list) {
+    const size_t chunkSize = 65536;
+    std::string chunk;
+    int nr = 0;
+
+    for (auto &str : list) {
+        if (chunk.size() && chunk.size() + str.size() >= chunkSize) {
+            setenv((name + "_" + std::to_string(nr++)).c_str(), chunk.c_str(), 1);
+            chunk.clear();
+        }
+        chunk += (chunk.empty() ? "" : ",") + str;
+    }
+
+    if (chunk.size())
+        setenv((name + "_" + std::to_string(nr++)).c_str(), chunk.c_str(), 1);
+}
+
+static void GetUpgradeEnv(const std::string &name, std::vector<std::string> &list) {
+    for (int nr = 0; ; nr++) {
+        std::string var = name + "_" + std::to_string(nr);
+        const char *val = getenv(var.c_str());
+        if (!val)
+            break;
+        (void)SplitString(val, ',', list);
+        unsetenv(var.c_str());
+    }
+}
+
+// Collects fds handed over by exiting slave and keeps them across exec.
+// Slave sends them before exit, socket is drained meanwhile so it never
+// fills up whatever number of containers and clients there is.
+static void ReceiveUpgradeFds(int sock) {
+    CloseUpgradeFds();
+
+    while (true) {
+        DrainUpgradeFds(sock);
+
+        pid_t pid = waitpid(slavePid, NULL, WNOHANG);
+        if (pid == slavePid)
+            break;
+
+        if (pid < 0 && errno != EINTR) {
+            L_ERR() << "Can't wait for slave exit status: " << strerror(errno) << std::endl;
+            CloseUpgradeFds();
+            return;
+        }
+
+        struct pollfd pfd = { sock, POLLIN, 0 };
+        (void)poll(&pfd, 1, 100);
+    }
+
+    // everything sent before exit is still queued
+    DrainUpgradeFds(sock);
+
+    if ((upgradeFds.size() || upgradeOomFds.size()) && !UpgradeFdsSupported()) {
+        L_WRN() << "New version doesn't support handed over fds, closing them" << std::endl;
+        CloseUpgradeFds();
+    }
+
+    std::vector<std::string> list, oomList;
+    for (auto fd : upgradeFds)
+        list.push_back(std::to_string(fd));
+    for (auto &it : upgradeOomFds)
+        oomList.push_back(it.first + "=" + std::to_string(it.second));
+
+    if (upgradeFds.size() || upgradeOomFds.size())
+        L_SYS() << "Got " << upgradeFds.size() << " RPC fds and "
+                << upgradeOomFds.size() << " OOM eventfds from slave" << std::endl;
+
+    SetUpgradeEnv("PORTO_UPGRADE_FDS", list);
+    SetUpgradeEnv("PORTO_UPGRADE_OOM_FDS", oomList);
+}
+
 static int SpawnSlave(std::shared_ptr<TEpollLoop> loop, map<int,int> &exited) {
     int evtfd[2];
     int ackfd[2];
+    int upgradefd[2];
     int ret = EXIT_FAILURE;
     TError error;
 
@@ -737,6 +1146,11 @@ static int SpawnSlave(std::shared_ptr<TEpollLoop> loop, map<int,int> &exited) {
         return EXIT_FAILURE;
     }
 
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, upgradefd) < 0) {
+        L_ERR() << "socketpair(): " << strerror(errno) << std::endl;
+        return EXIT_FAILURE;
+    }
+
     slavePid = fork();
     if (slavePid < 0) {
         L_ERR() << "fork(): " << strerror(errno) << std::endl;
@@ -745,18 +1159,25 @@ static int SpawnSlave(std::shared_ptr<TEpollLoop> loop, map<int,int> &exited) {
     } else if (slavePid == 0) {
         close(evtfd[1]);
         close(ackfd[0]);
+        close(upgradefd[0]);
         TLogger::CloseLog();
         loop->Destroy();
         dup2(evtfd[0], REAP_EVT_FD);
         dup2(ackfd[1], REAP_ACK_FD);
+        dup2(upgradefd[1], UPGRADE_FD);
         close(evtfd[0]);
         close(ackfd[1]);
+        close(upgradefd[1]);
 
         exit(SlaveMain());
     }
 
     close(evtfd[0]);
     close(ackfd[1]);
+    close(upgradefd[1]);
+
+    // now they belong to the slave
+    CloseUpgradeFds();
 
     L_SYS() << "Spawned slave " << slavePid << std::endl;
     Statistics->Spawned++;
@@ -817,15 +1238,14 @@ static int SpawnSlave(std::shared_ptr<TEpollLoop> loop, map<int,int> &exited) {
                 if (stdlog)
                     stdlogArg = "--stdlog";
 
-                if (kill(slavePid, updateSignal) < 0) {
+                if (kill(slavePid, updateSignal) < 0)
                     L_ERR() << "Can't send " << updateSignal << " to slave: " << strerror(errno) << std::endl;
-                } else {
-                    if (waitpid(slavePid, NULL, 0) != slavePid)
-                        L_ERR() << "Can't wait for slave exit status: " << strerror(errno) << std::endl;
-                }
+                else
+                    ReceiveUpgradeFds(upgradefd[0]);
                 TLogger::CloseLog();
                 close(evtfd[1]);
                 close(ackfd[0]);
+                close(upgradefd[0]);
                 loop->Destroy();
                 execlp(program_invocation_name, program_invocation_name, stdlogArg, nullptr);
                 std::cerr << "Can't execlp(" << program_invocation_name << ", " << program_invocation_name << ", NULL)" << strerror(errno) << std::endl;
@@ -874,6 +1294,9 @@ exit:
     close(ackfd[0]);
     close(ackfd[1]);
 
+    close(upgradefd[0]);
+    close(upgradefd[1]);
+
     return ret;
 }
 
@@ -1018,6 +1441,9 @@ int main(int argc, char * const argv[]) {
         if (arg == "-v" || arg == "--version") {
             std::cout << GIT_TAG << " " << GIT_REVISION <<std::endl;
             return EXIT_SUCCESS;
+        } else if (arg == "--upgrade-fds") {
+            // previous version checks that we take over its fds
+            return EXIT_SUCCESS;
         } else if (arg == "--kv-dump") {
             KvDump();
             return EXIT_SUCCESS;
@@ -1041,7 +1467,26 @@ int main(int argc, char * const argv[]) {
         }
     }
 
-    if (!slaveMode && AnotherInstanceRunning(config().rpc_sock().file().path())) {
+    std::vector<std::string> list;
+    GetUpgradeEnv("PORTO_UPGRADE_FDS", list);
+    for (auto &str : list) {
+        int fd;
+        if (!StringToInt(str, fd))
+            upgradeFds.push_back(fd);
+    }
+
+    list.clear();
+    GetUpgradeEnv("PORTO_UPGRADE_OOM_FDS", list);
+    for (auto &str : list) {
+        auto sep = str.rfind('=');
+        int fd;
+        if (sep != std::string::npos && !StringToInt(str.substr(sep + 1), fd))
+            upgradeOomFds[str.substr(0, sep)] = fd;
+    }
+
+    // previous instance handed us its RPC socket, don't connect to it
+    if (!slaveMode && upgradeFds.empty() &&
+            AnotherInstanceRunning(config().rpc_sock().file().path())) {
         std::cerr << "Another instance of portod is running!" << std::endl;
         return EXIT_FAILURE;
     }
@@ -2,3 +2,4 @@
 
 const int REAP_EVT_FD = 128;
 const int REAP_ACK_FD = 129;
+const int UPGRADE_FD = 130;
@@ -53,9 +53,23 @@ static int Fuzzytest(int argc, char *argv[]) {
     return test::FuzzyTest(threads, iter);
 }
 
+static int Benchtest(int argc, char *argv[]) {
+    std::vector<std::string> test;
+    int nr = 1000;
+
+    for (int i = 0; i < argc; i++) {
+        TError error = StringToInt(argv[i], nr);
+        if (error)
+            test.push_back(argv[i]);
+    }
+
+    return test::BenchTest(test, nr);
+}
+
 static void Usage() {
     std::cout << "usage: " << program_invocation_short_name << " [selftest name]" << std::endl;
     std::cout << "       " << program_invocation_short_name << " stress [threads] [iterations] [kill=on/off]" << std::endl;
+    std::cout << "       " << program_invocation_short_name << " bench [name] [iterations]" << std::endl;
 }
 
 static int TestConnectivity() {
@@ -114,6 +128,8 @@ int main(int argc, char *argv[])
             return Stresstest(argc - 2, argv + 2);
         if (what == "fuzzy")
             return Fuzzytest(argc - 2, argv + 2);
+        if (what == "bench")
+            return Benchtest(argc - 2, argv + 2);
         else if (what == "connectivity")
             return TestConnectivity();
         else
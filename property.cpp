@@ -18,25 +18,19 @@ extern "C" {
 }
 
 std::string TPropertyMap::ToString(const std::string &name) const {
-    if (IsDefault(name)) {
-        std::shared_ptr<TContainer> c;
-        if (ParentDefault(c, name))
-            if (c && c->GetParent())
-                return c->GetParent()->Prop->ToString(name);
+    int index = GetIndex(name);
+    if (!Slot(index).HasValue() && ParentDefault(index)) {
+        auto c = GetContainer();
+        if (c && c->GetParent())
+            return c->GetParent()->Prop->ToString(name);
     }
 
     return TValueMap::ToString(name);
 }
 
-bool TPropertyMap::ParentDefault(std::shared_ptr<TContainer> &c,
-                                 const std::string &property) const {
-    TError error = GetSharedContainer(c);
-    if (error) {
-        L_ERR() << "Can't get default for " << property << ": " << error << std::endl;
-        return false;
-    }
-
-    return HasFlags(property, PARENT_DEF_PROPERTY) && !GetRaw<bool>(P_ISOLATE);
+bool TPropertyMap::ParentDefault(int index) const {
+    return (Table->Get(index)->GetFlags() & PARENT_DEF_PROPERTY) &&
+           !GetRaw(Props::Isolate);
 }
 
 bool TPropertyMap::HasFlags(const std::string &property, int flags) const {
@@ -75,27 +69,8 @@ TError TPropertyMap::Check(const std::string &property) const {
 
 TError TPropertyMap::PrepareTaskEnv(const std::string &property,
                                     std::shared_ptr<TTaskEnv> taskEnv) {
-    auto av = Find(property);
-
-    if (IsDefault(property)) {
-        // if the value is default we still need PrepareTaskEnv method
-        // to be called, so set value to default and then reset it
-        TError error = av->FromString(av->DefaultString());
-        if (error)
-            return error;
-
-        av->Reset();
-    }
-
-    return ToContainerValue(av)->PrepareTaskEnv(taskEnv);
-}
-
-TError TPropertyMap::GetSharedContainer(std::shared_ptr<TContainer> &c) const {
-    c = Container.lock();
-    if (!c)
-        return TError(EError::Unknown, "Can't convert weak container reference");
-
-    return TError::Success();
+    TValueScope scope(this);
+    return ToContainerValue(Find(property))->PrepareTaskEnv(taskEnv);
 }
 
 static TError ValidPath(const std::string &str) {
@@ -177,7 +152,7 @@ public:
                         staticProperty) {}
 
     std::string GetDefault() const override {
-        if (GetContainer()->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS)
+        if (GetContainer()->Prop->Get(Props::VirtMode) == VIRT_MODE_OS)
             return "/sbin/init";
 
         return "";
@@ -197,8 +172,8 @@ public:
         TUser u(value);
         TError error(EError::InvalidValue, "");
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS) {
-            TPath root = c->Prop->Get<std::string>(P_ROOT);
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS) {
+            TPath root = c->Prop->Get(Props::Root);
             TPath passwd = root / "etc" / "passwd";
             if (root.ToString() != "/" && passwd.Exists())
                 error = u.LoadFromFile(passwd);
@@ -229,8 +204,8 @@ public:
         TGroup g(value);
         TError error(EError::InvalidValue, "");
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS) {
-            TPath root = c->Prop->Get<std::string>(P_ROOT);
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS) {
+            TPath root = c->Prop->Get(Props::Root);
             TPath group = root / "etc" / "group";
             if (root.ToString() != "/" && group.Exists())
                 error = g.LoadFromFile(group);
@@ -293,7 +268,7 @@ public:
                 return error;
         }
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS) {
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS) {
             TPath root(value);
             TPath realRoot("/");
 
@@ -330,7 +305,7 @@ public:
     std::string GetDefault() const override {
         auto c = GetContainer();
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS)
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS)
             return "/";
 
         if (!c->Prop->IsDefault(P_ROOT))
@@ -378,7 +353,7 @@ public:
     std::string GetDefault() const override {
         auto c = GetContainer();
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS)
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS)
             return "/dev/null";
 
         return DefaultStdFile(c, "stdout");
@@ -411,7 +386,7 @@ public:
     std::string GetDefault() const override {
         auto c = GetContainer();
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS)
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS)
             return "/dev/null";
 
         return DefaultStdFile(c, "stderr");
@@ -807,8 +782,6 @@ public:
 };
 
 class TUlimitProperty : public TListValue, public TContainerValue {
-    std::map<int,struct rlimit> Rlimit;
-
 public:
     TUlimitProperty() :
         TListValue(PARENT_DEF_PROPERTY | PERSISTENT_VALUE),
@@ -816,8 +789,9 @@ public:
                         "Container resource limits: <type> <soft> <hard>; ... (man 2 getrlimit)",
                         staticProperty) {}
 
-    TError CheckValue(const std::vector<std::string> &lines) override {
-        Rlimit.clear();
+    TError Parse(const std::vector<std::string> &lines,
+                 std::map<int,struct rlimit> &rlimit) const {
+        rlimit.clear();
 
         static const std::map<std::string,int> nameToIdx = {
             { "as", RLIMIT_AS },
@@ -872,16 +846,20 @@ public:
                     return TError(EError::InvalidValue, "Invalid hard limit for " + name);
             }
 
-            Rlimit[idx].rlim_cur = soft;
-            Rlimit[idx].rlim_max = hard;
+            rlimit[idx].rlim_cur = soft;
+            rlimit[idx].rlim_max = hard;
         }
 
         return TError::Success();
     }
 
+    TError CheckValue(const std::vector<std::string> &lines) override {
+        std::map<int,struct rlimit> rlimit;
+        return Parse(lines, rlimit);
+    }
+
     TError PrepareTaskEnv(std::shared_ptr<TTaskEnv> taskEnv) override {
-        taskEnv->Rlimit = Rlimit;
-        return TError::Success();
+        return Parse(Get(), taskEnv->Rlimit);
     }
 };
 
@@ -905,11 +883,11 @@ public:
     bool GetDefault() const override {
         auto c = GetContainer();
 
-        auto vmode = c->Prop->Get<int>(P_VIRT_MODE);
+        auto vmode = c->Prop->Get(Props::VirtMode);
         if (vmode == VIRT_MODE_OS)
             return false;
 
-        if (!c->Prop->Get<bool>(P_ISOLATE))
+        if (!c->Prop->Get(Props::Isolate))
             return false;
         else if (c->Prop->IsDefault(P_ROOT))
             return false;
@@ -919,8 +897,6 @@ public:
 };
 
 class TBindProperty : public TListValue, public TContainerValue {
-    std::vector<TBindMap> BindMap;
-
 public:
     TBindProperty() :
         TListValue(PARENT_RO_PROPERTY | PARENT_DEF_PROPERTY | PERSISTENT_VALUE),
@@ -928,10 +904,11 @@ public:
                         "Share host directories with container: <host_path> <container_path> [ro|rw]; ...",
                         staticProperty) {}
 
-    TError CheckValue(const std::vector<std::string> &lines) override {
+    TError Parse(const std::vector<std::string> &lines,
+                 std::vector<TBindMap> &bm) const {
         auto c = GetContainer();
 
-        std::vector<TBindMap> bm;
+        bm.clear();
 
         for (auto &line : lines) {
             std::vector<std::string> tok;
@@ -967,19 +944,20 @@ public:
             bm.push_back(m);
         }
 
-        BindMap = bm;
-
         return TError::Success();
     }
 
+    TError CheckValue(const std::vector<std::string> &lines) override {
+        std::vector<TBindMap> bm;
+        return Parse(lines, bm);
+    }
+
     TError PrepareTaskEnv(std::shared_ptr<TTaskEnv> taskEnv) override {
-        taskEnv->BindMap = BindMap;
-        return TError::Success();
+        return Parse(Get(), taskEnv->BindMap);
     }
 };
 
 class TDefaultGwProperty : public TListValue, public TContainerValue {
-    std::vector<TGwVec> GwVec;
 public:
     TDefaultGwProperty() :
         TListValue(PARENT_RO_PROPERTY | PERSISTENT_VALUE | HIDDEN_VALUE),
@@ -987,8 +965,9 @@ public:
                         "Default gateway: <interface> <ip>; ...",
                         staticProperty) {}
 
-    TError CheckValue(const std::vector<std::string> &lines) override {
-        std::vector<TGwVec> gwvec;
+    TError Parse(const std::vector<std::string> &lines,
+                 std::vector<TGwVec> &gwvec) const {
+        gwvec.clear();
 
         for (auto &line : lines) {
             std::vector<std::string> settings;
@@ -1007,19 +986,20 @@ public:
             gwvec.push_back(gw);
         }
 
-        GwVec = gwvec;
         return TError::Success();
     }
 
+    TError CheckValue(const std::vector<std::string> &lines) override {
+        std::vector<TGwVec> gwvec;
+        return Parse(lines, gwvec);
+    }
+
     TError PrepareTaskEnv(std::shared_ptr<TTaskEnv> taskEnv) override {
-        taskEnv->GwVec = GwVec;
-        return TError::Success();
+        return Parse(Get(), taskEnv->GwVec);
     }
 };
 
 class TIpProperty : public TListValue, public TContainerValue {
-    std::vector<TIpVec> IpVec;
-
 public:
     TIpProperty() :
         TListValue(PARENT_RO_PROPERTY | PERSISTENT_VALUE | HIDDEN_VALUE),
@@ -1027,8 +1007,9 @@ public:
                         "IP configuration: <interface> <ip>/<prefix>; ...",
                         staticProperty) {}
 
-    TError CheckValue(const std::vector<std::string> &lines) override {
-        std::vector<TIpVec> ipvec;
+    TError Parse(const std::vector<std::string> &lines,
+                 std::vector<TIpVec> &ipvec) const {
+        ipvec.clear();
 
         for (auto &line : lines) {
             std::vector<std::string> settings;
@@ -1047,19 +1028,20 @@ public:
             ipvec.push_back(ip);
         }
 
-        IpVec = ipvec;
         return TError::Success();
     }
 
+    TError CheckValue(const std::vector<std::string> &lines) override {
+        std::vector<TIpVec> ipvec;
+        return Parse(lines, ipvec);
+    }
+
     TError PrepareTaskEnv(std::shared_ptr<TTaskEnv> taskEnv) override {
-        taskEnv->IpVec = IpVec;
-        return TError::Success();
+        return Parse(Get(), taskEnv->IpVec);
     }
 };
 
 class TNetProperty : public TListValue, public TContainerValue {
-    TNetCfg NetCfg;
-
 public:
     TNetProperty() :
         TListValue(PARENT_RO_PROPERTY | PERSISTENT_VALUE),
@@ -1079,15 +1061,13 @@ public:
     TStrList GetDefault() const override {
         auto c = GetContainer();
 
-        if (c->Prop->Get<int>(P_VIRT_MODE) == VIRT_MODE_OS)
+        if (c->Prop->Get(Props::VirtMode) == VIRT_MODE_OS)
             return TStrList{ "none" };
 
         return TStrList{ "inherited" };
     }
 
-    TError CheckValue(const std::vector<std::string> &lines) override {
-        TNetCfg cfg;
-
+    TError Parse(const std::vector<std::string> &lines, TNetCfg &cfg) const {
         bool none = false;
         cfg.Clear();
         int idx = 0;
@@ -1273,14 +1253,16 @@ public:
         if (single > 1 || (single == 1 && mixed))
             return TError(EError::InvalidValue, "none/host/inherited can't be mixed with other types");
 
-        NetCfg = cfg;
-
         return TError::Success();
     }
 
+    TError CheckValue(const std::vector<std::string> &lines) override {
+        TNetCfg cfg;
+        return Parse(lines, cfg);
+    }
+
     TError PrepareTaskEnv(std::shared_ptr<TTaskEnv> taskEnv) override {
-        taskEnv->NetCfg = NetCfg;
-        return TError::Success();
+        return Parse(Get(), taskEnv->NetCfg);
     }
 };
 
@@ -1304,7 +1286,7 @@ public:
                         staticProperty) {}
 
     TStrList GetDefault() const override {
-        auto vmode = GetContainer()->Prop->Get<int>(P_VIRT_MODE);
+        auto vmode = GetContainer()->Prop->Get(Props::VirtMode);
 
         if (vmode == VIRT_MODE_OS)
             return TStrList{
@@ -1392,7 +1374,7 @@ public:
         auto c = GetContainer();
 
         bool root = c->OwnerCred.IsRoot();
-        auto vmode = c->Prop->Get<int>(P_VIRT_MODE);
+        auto vmode = c->Prop->Get(Props::VirtMode);
         bool restricted = vmode == VIRT_MODE_OS;
 
         uint64_t lastCap = GetLastCap();
@@ -1485,8 +1467,8 @@ public:
     TError CheckValue(const bool &value) override {
         if (value == false) {
             auto c = GetContainer();
-            if (c->Prop->Get<std::string>(P_ROOT) == "/" ||
-                c->Prop->Get<std::string>(P_PORTO_NAMESPACE).empty())
+            if (c->Prop->Get(Props::Root) == "/" ||
+                c->Prop->Get(Props::PortoNamespace).empty())
                 return TError(EError::InvalidValue, "Can't disable porto socket when container is not isolated");
         }
 
@@ -1538,58 +1520,19 @@ public:
         TContainerValue(P_RAW_DEATH_TIME, "", anyState) {}
 };
 
+static TValueTable *NewPropertyTable() {
+    auto table = new TValueTable;
+
+#define PORTO_PROPERTY_ADD(key, type, name, cls) \
+    AddContainerValue(*table, Props::key, new cls);
+    PORTO_PROPERTIES(PORTO_PROPERTY_ADD)
+#undef PORTO_PROPERTY_ADD
+
+    return table;
+}
+
 void RegisterProperties(std::shared_ptr<TRawValueMap> m,
                         std::shared_ptr<TContainer> c) {
-    const std::vector<TAbstractValue *> properties = {
-        new TCommandProperty,
-        new TUserProperty,
-        new TGroupProperty,
-        new TEnvProperty,
-        new TPortoNamespaceProperty,
-        new TRootProperty,
-        new TRootRdOnlyProperty,
-        new TCwdProperty,
-        new TStdinPathProperty,
-        new TStdoutPathProperty,
-        new TStderrPathProperty,
-        new TStdoutLimitProperty,
-        new TMemoryGuaranteeProperty,
-        new TMemoryLimitProperty,
-        new TRechargeOnPgfaultProperty,
-        new TCpuPolicyProperty,
-        new TCpuLimitProperty,
-        new TCpuGuaranteeProperty,
-        new TIoPolicyProperty,
-        new TIoLimitProperty,
-        new TNetGuaranteeProperty,
-        new TNetLimitProperty,
-        new TNetPriorityProperty,
-        new TRespawnProperty,
-        new TMaxRespawnsProperty,
-        new TIsolateProperty,
-        new TPrivateProperty,
-        new TUlimitProperty,
-        new THostnameProperty,
-        new TBindDnsProperty,
-        new TBindProperty,
-        new TNetProperty,
-        new TNetTosProperty,
-        new TAllowedDevicesProperty,
-        new TCapabilitiesProperty,
-        new TIpProperty,
-        new TDefaultGwProperty,
-        new TVirtModeProperty,
-        new TAgingTimeProperty,
-        new TEnablePortoProperty,
-
-        new TRawIdProperty,
-        new TRawRootPidProperty,
-        new TRawLoopDevProperty,
-        new TRawNameProperty,
-        new TRawStartTimeProperty,
-        new TRawDeathTimeProperty,
-    };
-
-    for (auto p : properties)
-        AddContainerValue(m, c, p);
+    static const TValueTable *table = NewPropertyTable();
+    m->SetTable(*table, c);
 }
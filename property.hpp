@@ -57,6 +57,70 @@ constexpr const char *P_VIRT_MODE = "virt_mode";
 constexpr const char *P_AGING_TIME = "aging_time";
 constexpr const char *P_ENABLE_PORTO = "enable_porto";
 
+// All properties in registration order: key, value type, name and class.
+// Slot of each key is its position here, so keys and table can't diverge.
+#define PORTO_PROPERTIES(X) \
+    X(Command, std::string, P_COMMAND, TCommandProperty) \
+    X(User, std::string, P_USER, TUserProperty) \
+    X(Group, std::string, P_GROUP, TGroupProperty) \
+    X(Env, TStrList, P_ENV, TEnvProperty) \
+    X(PortoNamespace, std::string, P_PORTO_NAMESPACE, TPortoNamespaceProperty) \
+    X(Root, std::string, P_ROOT, TRootProperty) \
+    X(RootRdOnly, bool, P_ROOT_RDONLY, TRootRdOnlyProperty) \
+    X(Cwd, std::string, P_CWD, TCwdProperty) \
+    X(StdinPath, std::string, P_STDIN_PATH, TStdinPathProperty) \
+    X(StdoutPath, std::string, P_STDOUT_PATH, TStdoutPathProperty) \
+    X(StderrPath, std::string, P_STDERR_PATH, TStderrPathProperty) \
+    X(StdoutLimit, uint64_t, P_STDOUT_LIMIT, TStdoutLimitProperty) \
+    X(MemGuarantee, uint64_t, P_MEM_GUARANTEE, TMemoryGuaranteeProperty) \
+    X(MemLimit, uint64_t, P_MEM_LIMIT, TMemoryLimitProperty) \
+    X(RechargeOnPgfault, bool, P_RECHARGE_ON_PGFAULT, TRechargeOnPgfaultProperty) \
+    X(CpuPolicy, std::string, P_CPU_POLICY, TCpuPolicyProperty) \
+    X(CpuLimit, uint64_t, P_CPU_LIMIT, TCpuLimitProperty) \
+    X(CpuGuarantee, uint64_t, P_CPU_GUARANTEE, TCpuGuaranteeProperty) \
+    X(IoPolicy, std::string, P_IO_POLICY, TIoPolicyProperty) \
+    X(IoLimit, uint64_t, P_IO_LIMIT, TIoLimitProperty) \
+    X(NetGuarantee, TUintMap, P_NET_GUARANTEE, TNetGuaranteeProperty) \
+    X(NetLimit, TUintMap, P_NET_LIMIT, TNetLimitProperty) \
+    X(NetPrio, TUintMap, P_NET_PRIO, TNetPriorityProperty) \
+    X(Respawn, bool, P_RESPAWN, TRespawnProperty) \
+    X(MaxRespawns, int, P_MAX_RESPAWNS, TMaxRespawnsProperty) \
+    X(Isolate, bool, P_ISOLATE, TIsolateProperty) \
+    X(Private, std::string, P_PRIVATE, TPrivateProperty) \
+    X(Ulimit, TStrList, P_ULIMIT, TUlimitProperty) \
+    X(Hostname, std::string, P_HOSTNAME, THostnameProperty) \
+    X(BindDns, bool, P_BIND_DNS, TBindDnsProperty) \
+    X(Bind, TStrList, P_BIND, TBindProperty) \
+    X(Net, TStrList, P_NET, TNetProperty) \
+    X(NetTos, uint64_t, P_NET_TOS, TNetTosProperty) \
+    X(AllowedDevices, TStrList, P_ALLOWED_DEVICES, TAllowedDevicesProperty) \
+    X(Capabilities, TStrList, P_CAPABILITIES, TCapabilitiesProperty) \
+    X(Ip, TStrList, P_IP, TIpProperty) \
+    X(DefaultGw, TStrList, P_DEFAULT_GW, TDefaultGwProperty) \
+    X(VirtMode, int, P_VIRT_MODE, TVirtModeProperty) \
+    X(AgingTime, uint64_t, P_AGING_TIME, TAgingTimeProperty) \
+    X(EnablePorto, bool, P_ENABLE_PORTO, TEnablePortoProperty) \
+    X(RawId, int, P_RAW_ID, TRawIdProperty) \
+    X(RawRootPid, int, P_RAW_ROOT_PID, TRawRootPidProperty) \
+    X(RawLoopDev, int, P_RAW_LOOP_DEV, TRawLoopDevProperty) \
+    X(RawName, std::string, P_RAW_NAME, TRawNameProperty) \
+    X(RawStartTime, uint64_t, P_RAW_START_TIME, TRawStartTimeProperty) \
+    X(RawDeathTime, uint64_t, P_RAW_DEATH_TIME, TRawDeathTimeProperty)
+
+// Typed keys of properties, see NewPropertyTable() in property.cpp
+namespace Props {
+enum EIndex {
+#define PORTO_PROPERTY_INDEX(key, type, name, cls) key##Index,
+    PORTO_PROPERTIES(PORTO_PROPERTY_INDEX)
+#undef PORTO_PROPERTY_INDEX
+};
+
+#define PORTO_PROPERTY_KEY(key, type, name, cls) \
+    constexpr TValueKey<type> key = { key##Index, name };
+PORTO_PROPERTIES(PORTO_PROPERTY_KEY)
+#undef PORTO_PROPERTY_KEY
+}
+
 constexpr int VIRT_MODE_APP = 0;
 constexpr int VIRT_MODE_OS = 1;
 
@@ -79,19 +143,13 @@ const unsigned int OS_MODE_PROPERTY = (1 << 4);
 const unsigned int PATH_PROPERTY = (1 << 5);
 
 class TPropertyMap : public TValueMap {
-    std::weak_ptr<TContainer> Container;
-
-    TError GetSharedContainer(std::shared_ptr<TContainer> &c) const;
+    // unset value should be taken from parent
+    bool ParentDefault(int index) const;
 
 public:
-    TPropertyMap(std::shared_ptr<TKeyValueNode> kvnode,
-                 std::shared_ptr<TContainer> c) :
-        TValueMap(kvnode),
-        Container(c) {}
+    TPropertyMap(std::shared_ptr<TKeyValueNode> kvnode) : TValueMap(kvnode) {}
 
     std::string ToString(const std::string &name) const;
-    bool ParentDefault(std::shared_ptr<TContainer> &c,
-                       const std::string &property) const;
 
     bool HasFlags(const std::string &property, int flags) const;
     bool HasState(const std::string &property, EContainerState state) const;
@@ -104,14 +162,25 @@ public:
 
     template<typename T>
     const T Get(const std::string &name) const {
-        if (IsDefault(name)) {
-            std::shared_ptr<TContainer> c;
-            if (ParentDefault(c, name))
-                if (c && c->GetParent())
-                    return c->GetParent()->Prop->Get<T>(name);
+        int index = GetIndex(name);
+        if (!Slot(index).HasValue() && ParentDefault(index)) {
+            auto c = GetContainer();
+            if (c && c->GetParent())
+                return c->GetParent()->Prop->Get<T>(name);
         }
 
-        return TValueMap::Get<T>(name);
+        return GetAt<T>(index);
+    }
+
+    template<typename T>
+    const T Get(const TValueKey<T> &key) const {
+        if (!Slot(key.Index).HasValue() && ParentDefault(key.Index)) {
+            auto c = GetContainer();
+            if (c && c->GetParent())
+                return c->GetParent()->Prop->Get(key);
+        }
+
+        return TValueMap::Get(key);
     }
 
     template<typename T>
@@ -121,10 +190,20 @@ public:
         return TValueMap::Set<T>(name, value);
     }
 
+    template<typename T>
+    TError Set(const TValueKey<T> &key, const typename TValueKey<T>::Type &value) {
+        return TValueMap::Set(key, value);
+    }
+
     template<typename T>
     const T GetRaw(const std::string &name) const {
         return TValueMap::Get<T>(name);
     }
+
+    template<typename T>
+    const T GetRaw(const TValueKey<T> &key) const {
+        return TValueMap::Get(key);
+    }
 };
 
 void RegisterProperties(std::shared_ptr<TRawValueMap> m,
@@ -1,4 +1,8 @@
 #include <algorithm>
+#include <functional>
+#include <memory>
+
+#include <google/protobuf/arena.h>
 
 #include "rpc.hpp"
 #include "config.hpp"
@@ -9,6 +13,8 @@
 #include "container_value.hpp"
 #include "volume.hpp"
 #include "event.hpp"
+#include "subsystem.hpp"
+#include "metrics.hpp"
 #include "util/log.hpp"
 #include "util/protobuf.hpp"
 #include "util/string.hpp"
@@ -86,7 +92,17 @@ static std::string RequestAsString(const rpc::TContainerRequest &req) {
                                       req.unlinkvolume().container();
     else if (req.has_listvolumes())
         return "volumeAPI: list volumes";
-    else
+    else if (req.has_batch()) {
+        std::string ret = "batch";
+
+        for (auto &subreq : req.batch().request())
+            ret += " [" + RequestAsString(subreq) + "]";
+
+        if (req.batch().stop_on_error())
+            ret += " stop on error";
+
+        return ret;
+    } else
         return req.ShortDebugString();
 }
 
@@ -133,6 +149,10 @@ static std::string ResponseAsString(const rpc::TContainerResponse &resp) {
             }
         } else if (resp.has_version())
             ret = resp.version().tag() + " #" + resp.version().revision();
+        else if (resp.has_batch()) {
+            for (auto &subrsp : resp.batch().response())
+                ret += "[" + ResponseAsString(subrsp) + "] ";
+        }
         else if (resp.has_wait())
             ret = resp.wait().name() + " isn't running";
         else
@@ -202,6 +222,13 @@ static std::string ResponseAsString(const rpc::TContainerResponse &resp) {
 }
 
 static bool InfoRequest(const rpc::TContainerRequest &req) {
+    if (req.has_batch()) {
+        for (auto &subreq : req.batch().request())
+            if (!InfoRequest(subreq))
+                return false;
+        return true;
+    }
+
     return
         req.has_list() ||
         req.has_getproperty() ||
@@ -242,38 +269,79 @@ static bool ValidRequest(const rpc::TContainerRequest &req) {
         req.has_importlayer() +
         req.has_exportlayer() +
         req.has_removelayer() +
-        req.has_listlayers() == 1;
+        req.has_listlayers() +
+        req.has_batch() == 1;
+}
+
+static bool ContainerRequest(const rpc::TContainerRequest &req) {
+    return
+        req.has_create() ||
+        req.has_destroy() ||
+        req.has_list() ||
+        req.has_getproperty() ||
+        req.has_setproperty() ||
+        req.has_getdata() ||
+        req.has_get() ||
+        req.has_start() ||
+        req.has_stop() ||
+        req.has_pause() ||
+        req.has_resume() ||
+        req.has_propertylist() ||
+        req.has_datalist() ||
+        req.has_kill();
+}
+
+// might take minutes: unpack or pack tarballs, build or destroy volumes
+static bool VolumeRequest(const rpc::TContainerRequest &req) {
+    return
+        req.has_createvolume() ||
+        req.has_linkvolume() ||
+        req.has_unlinkvolume() ||
+        req.has_importlayer() ||
+        req.has_exportlayer() ||
+        req.has_removelayer();
+}
+
+ERequestClass ClassifyRequest(const rpc::TContainerRequest &req) {
+    if (InfoRequest(req))
+        return ERequestClass::Info;
+    if (VolumeRequest(req))
+        return ERequestClass::Volume;
+    return ERequestClass::Container;
+}
+
+// served from holder snapshot under container lock only
+static bool LocklessRequest(const rpc::TContainerRequest &req) {
+    if (!config().container().scoped_unlock())
+        return false;
+
+    return
+        req.has_list() ||
+        req.has_getproperty() ||
+        req.has_getdata() ||
+        req.has_get();
 }
 
 static void SendReply(std::shared_ptr<TClient> client,
                       rpc::TContainerResponse &response,
-                      bool log) {
+                      bool log, uint64_t startMs) {
     if (!client) {
         std::cout << "no client" << std::endl;
         return;
     }
 
-    google::protobuf::io::FileOutputStream post(client->GetFd());
-
     if (response.IsInitialized()) {
-        if (WriteDelimitedTo(response, &post)) {
-            post.Flush();
-
+        if (client->WriteResponse(response)) {
             if (log)
                 L_RSP() << ResponseAsString(response) << " to " << *client
-                        << " (request took " << client->GetRequestTime() << "ms)"
+                        << " (request took " << GetCurrentTimeMs() - startMs << "ms)"
                         << std::endl;
         } else {
             L_RSP() << "Protobuf write error for " << client->GetFd() << " " << strerror(errno) << std:: endl;
         }
     }
 
-    auto loop = client->EpollLoop.lock();
-    if (loop) {
-        TError error = loop->EnableSource(client);
-        if (error)
-            L_WRN() << "Can't enable client " << client->GetFd() << ": " << error << std::endl;
-    }
+    client->FinishRequest(response.has_id());
 }
 
 static TError CheckRequestPermissions(std::shared_ptr<TClient> client) {
@@ -286,9 +354,8 @@ static TError CheckRequestPermissions(std::shared_ptr<TClient> client) {
 noinline TError CreateContainer(TContext &context,
                                 const rpc::TContainerCreateRequest &req,
                                 rpc::TContainerResponse &rsp,
-                                std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                std::shared_ptr<TClient> client,
+                                TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -328,9 +395,8 @@ noinline TError CreateContainer(TContext &context,
 noinline TError DestroyContainer(TContext &context,
                                  const rpc::TContainerDestroyRequest &req,
                                  rpc::TContainerResponse &rsp,
-                                 std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                 std::shared_ptr<TClient> client,
+                                 TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -372,9 +438,8 @@ noinline TError DestroyContainer(TContext &context,
 noinline TError StartContainer(TContext &context,
                                const rpc::TContainerStartRequest &req,
                                rpc::TContainerResponse &rsp,
-                               std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                               std::shared_ptr<TClient> client,
+                               TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -430,7 +495,7 @@ noinline TError StartContainer(TContext &context,
                 return TError(EError::Busy, "Can't start busy container " + topContainer->GetName());
         }
 
-        std::string cmd = container->Prop->Get<std::string>(P_COMMAND);
+        std::string cmd = container->Prop->Get(Props::Command);
         bool meta = i + 1 != nameVec.end() && cmd.empty();
 
         auto parent = container->GetParent();
@@ -464,9 +529,8 @@ release:
 noinline TError StopContainer(TContext &context,
                               const rpc::TContainerStopRequest &req,
                               rpc::TContainerResponse &rsp,
-                              std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                              std::shared_ptr<TClient> client,
+                              TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -491,9 +555,8 @@ noinline TError StopContainer(TContext &context,
 noinline TError PauseContainer(TContext &context,
                                const rpc::TContainerPauseRequest &req,
                                rpc::TContainerResponse &rsp,
-                               std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                               std::shared_ptr<TClient> client,
+                               TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -518,9 +581,8 @@ noinline TError PauseContainer(TContext &context,
 noinline TError ResumeContainer(TContext &context,
                                 const rpc::TContainerResumeRequest &req,
                                 rpc::TContainerResponse &rsp,
-                                std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                std::shared_ptr<TClient> client,
+                                TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -542,22 +604,91 @@ noinline TError ResumeContainer(TContext &context,
     return err;
 }
 
+// Names of containers visible from clientContainer which match mask and state,
+// at most limit of them after cursor; next is set if there are more
+static TError FilterContainers(TContext &context, TContainer &clientContainer,
+                               const std::string &mask, const std::string &state,
+                               const std::string &cursor, uint32_t limit,
+                               std::vector<std::string> &names,
+                               std::string &next) {
+    if (state != "") {
+        bool known = false;
+        for (auto s: { EContainerState::Stopped, EContainerState::Dead,
+                       EContainerState::Running, EContainerState::Paused,
+                       EContainerState::Meta })
+            known |= TContainer::ContainerStateName(s) == state;
+        if (!known)
+            return TError(EError::InvalidValue, "Unknown container state " + state);
+    }
+
+    auto filter = [&] (const std::shared_ptr<TContainer> &c) -> bool {
+        if (c->IsPortoRoot())
+            return true;
+
+        if (state != "" && TContainer::ContainerStateName(c->GetState()) != state)
+            return true;
+
+        std::string name;
+        if (clientContainer.RelativeName(*c, name))
+            return true;
+
+        if (mask != "" && !StringMatch(name, mask))
+            return true;
+
+        if (limit && names.size() == limit) {
+            next = names.back();
+            return false;
+        }
+
+        names.push_back(name);
+        return true;
+    };
+
+    // index is ordered by absolute names, relative ones are the same
+    // order within namespace, root is visible from any namespace
+    std::string ns = clientContainer.GetPortoNamespace();
+    std::string prefix = ns + StringGlobPrefix(mask);
+    std::string after;
+
+    if (ns != "") {
+        if (cursor == "") {
+            std::shared_ptr<TContainer> root;
+            if (!context.Cholder->Find(ROOT_CONTAINER, root) && !filter(root))
+                return TError::Success();
+        }
+        if (cursor != "" && cursor != ROOT_CONTAINER)
+            after = ns + cursor;
+    } else
+        after = cursor;
+
+    context.Cholder->Walk(prefix, after, filter);
+
+    return TError::Success();
+}
+
 noinline TError ListContainers(TContext &context,
+                               const rpc::TContainerListRequest &req,
                                rpc::TContainerResponse &rsp,
-                               std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
+                               std::shared_ptr<TClient> client,
+                               TScopedLock &holder_lock) {
+    std::shared_ptr<TContainer> clientContainer;
+    TError err = client->GetContainer(clientContainer);
+    if (err)
+        return err;
 
-    for (auto &c : context.Cholder->List()) {
-        std::shared_ptr<TContainer> clientContainer;
-        TError err = client->GetContainer(clientContainer);
-        if (err)
-            return err;
+    std::vector<std::string> names;
+    std::string next;
 
-        std::string name;
-        err = clientContainer->RelativeName(*c, name);
-        if (!err)
-            rsp.mutable_list()->add_name(name);
-    }
+    err = FilterContainers(context, *clientContainer, req.mask(), req.state(),
+                           req.cursor(), req.limit(), names, next);
+    if (err)
+        return err;
+
+    auto list = rsp.mutable_list();
+    for (auto &name : names)
+        list->add_name(name);
+    if (next != "")
+        list->set_next_cursor(next);
 
     return TError::Success();
 }
@@ -565,9 +696,8 @@ noinline TError ListContainers(TContext &context,
 noinline TError GetContainerProperty(TContext &context,
                                      const rpc::TContainerGetPropertyRequest &req,
                                      rpc::TContainerResponse &rsp,
-                                     std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                     std::shared_ptr<TClient> client,
+                                     TScopedLock &holder_lock) {
     std::shared_ptr<TContainer> clientContainer;
     TError err = client->GetContainer(clientContainer);
     if (err)
@@ -593,9 +723,8 @@ noinline TError GetContainerProperty(TContext &context,
 noinline TError SetContainerProperty(TContext &context,
                                      const rpc::TContainerSetPropertyRequest &req,
                                      rpc::TContainerResponse &rsp,
-                                     std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                     std::shared_ptr<TClient> client,
+                                     TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -620,9 +749,8 @@ noinline TError SetContainerProperty(TContext &context,
 noinline TError GetContainerData(TContext &context,
                                  const rpc::TContainerGetDataRequest &req,
                                  rpc::TContainerResponse &rsp,
-                                 std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                 std::shared_ptr<TClient> client,
+                                 TScopedLock &holder_lock) {
     std::shared_ptr<TContainer> clientContainer;
     TError err = client->GetContainer(clientContainer);
     if (err)
@@ -637,8 +765,10 @@ noinline TError GetContainerData(TContext &context,
     if (!container->IsValid())
         return TError(EError::ContainerDoesNotExist, "container doesn't exist");
 
+    TMetricsStalenessScope staleness(req.max_staleness_ms());
+    TCgroupStatScope statScope;
     string value;
-    err = container->GetData(req.data(), value);
+    err = container->GetData(req.data(), value, client);
     if (!err)
         rsp.mutable_getdata()->set_value(value);
 
@@ -648,24 +778,40 @@ noinline TError GetContainerData(TContext &context,
 noinline TError GetContainerCombined(TContext &context,
                                      const rpc::TContainerGetRequest &req,
                                      rpc::TContainerResponse &rsp,
-                                     std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                                     std::shared_ptr<TClient> client,
+                                     TScopedLock &holder_lock) {
     if (!req.variable_size())
         return TError(EError::InvalidValue, "Properties/data are not specified");
 
-    if (!req.name_size())
+    bool filter = req.has_mask() || req.has_state();
+
+    if (!req.name_size() && !filter)
         return TError(EError::InvalidValue, "Containers are not specified");
 
+    if (req.name_size() && filter)
+        return TError(EError::InvalidValue, "Containers are specified by both name and mask");
+
     std::shared_ptr<TContainer> clientContainer;
     TError err = client->GetContainer(clientContainer);
     if (err)
         return err;
 
+    TMetricsStalenessScope staleness(req.max_staleness_ms());
+    TCgroupStatScope statScope;
     auto get = rsp.mutable_get();
 
-    for (int i = 0; i < req.name_size(); i++) {
-        auto relname = req.name(i);
+    std::vector<std::string> names(req.name().begin(), req.name().end());
+    if (filter) {
+        std::string next;
+        err = FilterContainers(context, *clientContainer, req.mask(), req.state(),
+                               req.cursor(), req.limit(), names, next);
+        if (err)
+            return err;
+        if (next != "")
+            get->set_next_cursor(next);
+    }
+
+    for (auto &relname : names) {
 
         auto entry = get->add_list();
         entry->set_name(relname);
@@ -676,12 +822,18 @@ noinline TError GetContainerCombined(TContext &context,
         TNestedScopedLock lock;
         TError containerError = clientContainer->AbsoluteName(relname, name, true);
         if (!containerError) {
-            containerError = context.Cholder->Get(name, container);
+            if (holder_lock.owns_lock())
+                containerError = context.Cholder->Get(name, container);
+            else
+                containerError = context.Cholder->Find(name, container);
             if (!containerError && container) {
                 if (container->IsAcquired()) {
                     containerError = TError(EError::Busy, "Can't get data and property of busy container");
                 } else {
-                    lock = TNestedScopedLock(*container, holder_lock);
+                    if (holder_lock.owns_lock())
+                        lock = TNestedScopedLock(*container, holder_lock);
+                    else
+                        lock = TNestedScopedLock(*container);
                     if (!container->IsValid())
                         containerError = TError(EError::ContainerDoesNotExist, "container doesn't exist");
                     else if (container->IsAcquired())
@@ -704,7 +856,7 @@ noinline TError GetContainerCombined(TContext &context,
                 if (container->Prop->IsValid(name))
                     error = container->GetProperty(var, value, client);
                 else if (container->Data->IsValid(name))
-                    error = container->GetData(var, value);
+                    error = container->GetData(var, value, client);
                 else
                     error = TError(EError::InvalidValue, "Unknown property or data " + var);
             }
@@ -723,9 +875,8 @@ noinline TError GetContainerCombined(TContext &context,
 }
 
 noinline TError ListProperty(TContext &context,
-                             rpc::TContainerResponse &rsp) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                             rpc::TContainerResponse &rsp,
+                             TScopedLock &holder_lock) {
     auto list = rsp.mutable_propertylist();
 
     std::shared_ptr<TContainer> container;
@@ -752,9 +903,8 @@ noinline TError ListProperty(TContext &context,
 }
 
 noinline TError ListData(TContext &context,
-                         rpc::TContainerResponse &rsp) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                         rpc::TContainerResponse &rsp,
+                         TScopedLock &holder_lock) {
     auto list = rsp.mutable_datalist();
 
     std::shared_ptr<TContainer> container;
@@ -783,9 +933,8 @@ noinline TError ListData(TContext &context,
 noinline TError Kill(TContext &context,
                      const rpc::TContainerKillRequest &req,
                      rpc::TContainerResponse &rsp,
-                     std::shared_ptr<TClient> client) {
-    auto holder_lock = context.Cholder->ScopedLock();
-
+                     std::shared_ptr<TClient> client,
+                     TScopedLock &holder_lock) {
     TError err = CheckRequestPermissions(client);
     if (err)
         return err;
@@ -816,6 +965,71 @@ noinline TError Version(TContext &context,
     return TError::Success();
 }
 
+// Responses which never change, encoded once at start
+static std::string PropertyListResponse;
+static std::string DataListResponse;
+static std::string VersionResponse;
+
+void EncodeStaticResponses(TContext &context) {
+    std::pair<std::string *, std::function<TError(rpc::TContainerResponse &,
+                                                  TScopedLock &)>> responses[] = {
+        { &PropertyListResponse, [&](rpc::TContainerResponse &rsp, TScopedLock &lock) {
+              return ListProperty(context, rsp, lock); } },
+        { &DataListResponse, [&](rpc::TContainerResponse &rsp, TScopedLock &lock) {
+              return ListData(context, rsp, lock); } },
+        { &VersionResponse, [&](rpc::TContainerResponse &rsp, TScopedLock &lock) {
+              return Version(context, rsp); } },
+    };
+
+    auto holder_lock = context.Cholder->ScopedLock();
+
+    for (auto &r : responses) {
+        rpc::TContainerResponse rsp;
+        TError error = r.second(rsp, holder_lock);
+        if (error) {
+            L_WRN() << "Can't encode static response: " << error << std::endl;
+            continue;
+        }
+
+        rsp.set_error(EError::Success);
+        if (!rsp.SerializeToString(r.first))
+            r.first->clear();
+    }
+}
+
+static bool SendStaticResponse(const rpc::TContainerRequest &req,
+                               std::shared_ptr<TClient> client) {
+    const std::string *encoded;
+
+    if (req.has_propertylist())
+        encoded = &PropertyListResponse;
+    else if (req.has_datalist())
+        encoded = &DataListResponse;
+    else if (req.has_version())
+        encoded = &VersionResponse;
+    else
+        return false;
+
+    if (encoded->empty())
+        return false;
+
+    std::string msg = *encoded;
+
+    // protobuf merges fields appended to encoded message
+    if (req.has_id()) {
+        rpc::TContainerResponse tail;
+        tail.set_id(req.id());
+        tail.AppendPartialToString(&msg);
+    }
+
+    if (!client->WriteResponse(msg))
+        L_RSP() << "Protobuf write error for " << client->GetFd() << " " << strerror(errno) << std:: endl;
+
+    client->FinishRequest(req.has_id());
+
+    return true;
+}
+
 noinline TError Wait(TContext &context,
                      const rpc::TContainerWaitRequest &req,
                      rpc::TContainerResponse &rsp,
@@ -830,12 +1044,18 @@ noinline TError Wait(TContext &context,
     if (err)
         return err;
 
-    auto fn = [] (std::shared_ptr<TClient> client,
-                  TError error, std::string name) {
+    // reply is sent later, remember request id
+    bool hasId = rsp.has_id();
+    uint64_t reqId = rsp.id();
+    uint64_t startMs = GetCurrentTimeMs();
+    auto fn = [hasId, reqId, startMs] (std::shared_ptr<TClient> client,
+                                       TError error, std::string name) {
         rpc::TContainerResponse response;
         response.set_error(error.GetError());
         response.mutable_wait()->set_name(name);
-        SendReply(client, response, true);
+        if (hasId)
+            response.set_id(reqId);
+        SendReply(client, response, true, startMs);
     };
 
     auto waiter = std::make_shared<TContainerWaiter>(client, fn);
@@ -859,7 +1079,7 @@ noinline TError Wait(TContext &context,
         container->AddWaiter(waiter);
     }
 
-    client->Waiter = waiter;
+    client->Waiters.insert(waiter);
 
     if (req.has_timeout()) {
         TEvent e(EEventType::WaitTimeout, nullptr);
@@ -1411,25 +1631,51 @@ noinline TError ListLayers(TContext &context,
     return error;
 }
 
-void HandleRpcRequest(TContext &context, const rpc::TContainerRequest &req,
-                      std::shared_ptr<TClient> client) {
-    rpc::TContainerResponse rsp;
-    string str;
+static TError HandleRequest(TContext &context,
+                            const rpc::TContainerRequest &req,
+                            rpc::TContainerResponse &rsp,
+                            std::shared_ptr<TClient> client,
+                            TScopedLock &holder_lock);
+
+noinline TError Batch(TContext &context,
+                      const rpc::TContainerBatchRequest &req,
+                      rpc::TContainerResponse &rsp,
+                      std::shared_ptr<TClient> client,
+                      TScopedLock &holder_lock) {
+    auto batch = rsp.mutable_batch();
+
+    for (auto &subreq : req.request()) {
+        auto subrsp = batch->add_response();
+        TError error;
+
+        // wait replies asynchronously and nested batches make no sense
+        if (!ValidRequest(subreq) || subreq.has_wait() || subreq.has_batch())
+            error = TError(EError::InvalidMethod, "invalid request in batch");
+        else
+            error = HandleRequest(context, subreq, *subrsp, client, holder_lock);
 
-    client->BeginRequest();
+        subrsp->set_error(error.GetError());
+        subrsp->set_errormsg(error.GetMsg());
 
-    bool log = config().log().verbose() || !InfoRequest(req);
-    if (log) {
-        std::string ns = "";
-        std::shared_ptr<TContainer> clientContainer;
-        TError error = client->GetContainer(clientContainer);
-        if (!error)
-            ns = clientContainer->GetPortoNamespace();
-
-        L_REQ() << RequestAsString(req) << " from " << *client << " [" << ns << "]" << std::endl;
+        if (error && req.stop_on_error())
+            break;
     }
 
-    rsp.set_error(EError::Unknown);
+    return TError::Success();
+}
+
+static TError HandleRequest(TContext &context,
+                            const rpc::TContainerRequest &req,
+                            rpc::TContainerResponse &rsp,
+                            std::shared_ptr<TClient> client,
+                            TScopedLock &holder_lock) {
+    // container requests of one batch share single holder lock acquisition,
+    // volume requests take holder lock on their own
+    bool needLock = ContainerRequest(req) && !LocklessRequest(req);
+    if (needLock && !holder_lock.owns_lock())
+        holder_lock.lock();
+    else if (!needLock && holder_lock.owns_lock())
+        holder_lock.unlock();
 
     TError error;
     try {
@@ -1437,33 +1683,33 @@ void HandleRpcRequest(TContext &context, const rpc::TContainerRequest &req,
             L_ERR() << "Invalid request " << req.ShortDebugString() << " from " << *client << std::endl;
             error = TError(EError::InvalidMethod, "invalid request");
         } else if (req.has_create())
-            error = CreateContainer(context, req.create(), rsp, client);
+            error = CreateContainer(context, req.create(), rsp, client, holder_lock);
         else if (req.has_destroy())
-            error = DestroyContainer(context, req.destroy(), rsp, client);
+            error = DestroyContainer(context, req.destroy(), rsp, client, holder_lock);
         else if (req.has_list())
-            error = ListContainers(context, rsp, client);
+            error = ListContainers(context, req.list(), rsp, client, holder_lock);
         else if (req.has_getproperty())
-            error = GetContainerProperty(context, req.getproperty(), rsp, client);
+            error = GetContainerProperty(context, req.getproperty(), rsp, client, holder_lock);
         else if (req.has_setproperty())
-            error = SetContainerProperty(context, req.setproperty(), rsp, client);
+            error = SetContainerProperty(context, req.setproperty(), rsp, client, holder_lock);
         else if (req.has_getdata())
-            error = GetContainerData(context, req.getdata(), rsp, client);
+            error = GetContainerData(context, req.getdata(), rsp, client, holder_lock);
         else if (req.has_get())
-            error = GetContainerCombined(context, req.get(), rsp, client);
+            error = GetContainerCombined(context, req.get(), rsp, client, holder_lock);
         else if (req.has_start())
-            error = StartContainer(context, req.start(), rsp, client);
+            error = StartContainer(context, req.start(), rsp, client, holder_lock);
         else if (req.has_stop())
-            error = StopContainer(context, req.stop(), rsp, client);
+            error = StopContainer(context, req.stop(), rsp, client, holder_lock);
         else if (req.has_pause())
-            error = PauseContainer(context, req.pause(), rsp, client);
+            error = PauseContainer(context, req.pause(), rsp, client, holder_lock);
         else if (req.has_resume())
-            error = ResumeContainer(context, req.resume(), rsp, client);
+            error = ResumeContainer(context, req.resume(), rsp, client, holder_lock);
         else if (req.has_propertylist())
-            error = ListProperty(context, rsp);
+            error = ListProperty(context, rsp, holder_lock);
         else if (req.has_datalist())
-            error = ListData(context, rsp);
+            error = ListData(context, rsp, holder_lock);
         else if (req.has_kill())
-            error = Kill(context, req.kill(), rsp, client);
+            error = Kill(context, req.kill(), rsp, client, holder_lock);
         else if (req.has_version())
             error = Version(context, rsp);
         else if (req.has_wait())
@@ -1486,6 +1732,8 @@ void HandleRpcRequest(TContext &context, const rpc::TContainerRequest &req,
             error = RemoveLayer(context, req.removelayer(), client);
         else if (req.has_listlayers())
             error = ListLayers(context, rsp);
+        else if (req.has_batch())
+            error = Batch(context, req.batch(), rsp, client, holder_lock);
         else
             error = TError(EError::InvalidMethod, "invalid RPC method");
     } catch (std::bad_alloc exc) {
@@ -1510,9 +1758,88 @@ void HandleRpcRequest(TContext &context, const rpc::TContainerRequest &req,
         error = TError(EError::Unknown, "unknown error");
     }
 
+    return error;
+}
+
+// Each worker thread builds responses in its own arena which is reset
+// after every request: large responses consist of many small messages
+// and strings which are all freed at once and memory is reused.
+// Workers live as long as daemon, arena is never freed.
+static __thread google::protobuf::Arena *workerArena;
+
+static google::protobuf::Arena &WorkerArena() {
+    if (!workerArena) {
+        const size_t blockSize = 256 * 1024;
+        google::protobuf::ArenaOptions options;
+
+        options.initial_block = new char[blockSize];
+        options.initial_block_size = blockSize;
+        workerArena = new google::protobuf::Arena(options);
+    }
+
+    return *workerArena;
+}
+
+class TArenaReset : public TNonCopyable {
+    google::protobuf::Arena &Arena;
+public:
+    TArenaReset(google::protobuf::Arena &arena) : Arena(arena) {}
+    ~TArenaReset() { Arena.Reset(); }
+};
+
+void HandleRpcRequest(TContext &context, const rpc::TContainerRequest &req,
+                      std::shared_ptr<TClient> client) {
+    auto &arena = WorkerArena();
+    TArenaReset arenaReset(arena);
+    auto &rsp = *google::protobuf::Arena::CreateMessage<rpc::TContainerResponse>(&arena);
+    uint64_t startMs = GetCurrentTimeMs();
+
+    bool log = config().log().verbose() || !InfoRequest(req);
+    if (log) {
+        std::string ns = "";
+        std::shared_ptr<TContainer> clientContainer;
+        TError error = client->GetContainer(clientContainer);
+        if (!error)
+            ns = clientContainer->GetPortoNamespace();
+
+        L_REQ() << RequestAsString(req) << " from " << *client << " [" << ns << "]" << std::endl;
+    }
+
+    rsp.set_error(EError::Unknown);
+    if (req.has_id())
+        rsp.set_id(req.id());
+
+    TError error;
+    if (!log && SendStaticResponse(req, client)) {
+        client->RequestsServed++;
+        return;
+    } else {
+        auto holder_lock = context.Cholder->ScopedLock(std::defer_lock);
+        error = HandleRequest(context, req, rsp, client, holder_lock);
+        client->RequestsServed++;
+    }
+
     if (error.GetError() != EError::Queued) {
         rsp.set_error(error.GetError());
         rsp.set_errormsg(error.GetMsg());
-        SendReply(client, rsp, log);
+        // response might be cleared by exception handler
+        if (req.has_id())
+            rsp.set_id(req.id());
+        SendReply(client, rsp, log, startMs);
     }
 }
+
+void RejectRpcRequest(const rpc::TContainerRequest &req,
+                      std::shared_ptr<TClient> client, const TError &error) {
+    rpc::TContainerResponse rsp;
+
+    if (config().log().verbose())
+        L_REQ() << RequestAsString(req) << " from " << *client << std::endl;
+
+    rsp.set_error(error.GetError());
+    rsp.set_errormsg(error.GetMsg());
+    if (req.has_id())
+        rsp.set_id(req.id());
+
+    SendReply(client, rsp, config().log().verbose(), GetCurrentTimeMs());
+}
@@ -4,5 +4,19 @@
 #include "context.hpp"
 #include "client.hpp"
 
+enum class ERequestClass {
+    Info,
+    Container,
+    Volume,
+};
+
+ERequestClass ClassifyRequest(const rpc::TContainerRequest &req);
+
+void EncodeStaticResponses(TContext &context);
+
 void HandleRpcRequest(TContext &context, const rpc::TContainerRequest &req,
                       std::shared_ptr<TClient> client);
+
+// replies with error to already queued request without handling it
+void RejectRpcRequest(const rpc::TContainerRequest &req,
+                      std::shared_ptr<TClient> client, const TError &error);
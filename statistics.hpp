@@ -2,6 +2,13 @@
 
 #include <atomic>
 
+struct TPoolStatistics {
+    std::atomic<uint64_t> Queued;
+    std::atomic<uint64_t> Requests;
+    std::atomic<uint64_t> WaitMs;
+    std::atomic<uint64_t> Rejected;
+};
+
 struct TStatistics {
     std::atomic<uint64_t> Spawned;
     std::atomic<uint64_t> Errors;
@@ -17,6 +24,22 @@ struct TStatistics {
     std::atomic<uint64_t> Rotated;
     std::atomic<uint64_t> RestoreFailed;
     std::atomic<uint64_t> EpollSources;
+    std::atomic<uint64_t> QueuedOutput;
+    std::atomic<uint64_t> OutputOverflows;
+    std::atomic<uint64_t> MetricsSamples;
+    std::atomic<uint64_t> KnobFds;
+    std::atomic<uint64_t> KvJournalWrites;
+    std::atomic<uint64_t> KvJournalRecords;
+    std::atomic<uint64_t> KvJournalCompactions;
+    std::atomic<uint64_t> KvReclaimedBytes;
+    std::atomic<uint64_t> RestoreLoadMs;
+    std::atomic<uint64_t> RestoreContainersMs;
+    std::atomic<uint64_t> RestoreVolumesMs;
+    std::atomic<uint64_t> RestoreSyncSkipped;
+    std::atomic<uint64_t> SpawnerTasks;
+    TPoolStatistics InfoPool;
+    TPoolStatistics ContainerPool;
+    TPoolStatistics VolumePool;
 };
 
 extern TStatistics *Statistics;
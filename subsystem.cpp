@@ -1,3 +1,6 @@
+#include <sstream>
+#include <mutex>
+
 #include "subsystem.hpp"
 #include "config.hpp"
 #include "cgroup.hpp"
@@ -22,6 +25,26 @@ shared_ptr<TNetclsSubsystem> netclsSubsystem(new TNetclsSubsystem);
 shared_ptr<TBlkioSubsystem> blkioSubsystem(new TBlkioSubsystem);
 shared_ptr<TDevicesSubsystem> devicesSubsystem(new TDevicesSubsystem);
 
+struct TCgroupStatCache {
+    // by path of statistics file
+    std::map<std::string, std::map<std::string, uint64_t>> MemoryStat;
+    std::map<std::string, std::vector<BlkioStat>> Blkio;
+};
+
+static __thread TCgroupStatCache *StatCache;
+
+TCgroupStatScope::TCgroupStatScope() : Owner(!StatCache) {
+    if (Owner)
+        StatCache = new TCgroupStatCache;
+}
+
+TCgroupStatScope::~TCgroupStatScope() {
+    if (Owner) {
+        delete StatCache;
+        StatCache = nullptr;
+    }
+}
+
 static const std::map<std::string, std::shared_ptr<TSubsystem>> subsystems = {
     { "memory", memorySubsystem },
     { "freezer", freezerSubsystem },
@@ -72,35 +95,53 @@ std::shared_ptr<TCgroup> TSubsystem::GetRootCgroup(std::shared_ptr<TMount> mount
 
 // Memory
 TError TMemorySubsystem::Usage(shared_ptr<TCgroup> cg, uint64_t &value) const {
-    string s;
-    TError error = cg->GetKnobValue("memory.usage_in_bytes", s);
+    return cg->GetKnobValue("memory.usage_in_bytes", value);
+}
+
+TError TMemorySubsystem::Statistics(std::shared_ptr<TCgroup> cg,
+                                    std::map<std::string, uint64_t> &stat) const {
+    string text;
+    TError error = cg->GetKnobValue("memory.stat", text);
     if (error)
         return error;
-    return StringToUint64(s, value);
+
+    std::stringstream ss(text);
+    string key;
+    uint64_t val;
+
+    while (ss >> key >> val)
+        stat[key] = val;
+
+    return TError::Success();
 }
 
 TError TMemorySubsystem::Statistics(std::shared_ptr<TCgroup> cg,
                                     const std::string &name,
                                     uint64_t &val) const {
-    vector<string> lines;
-    TError error = cg->GetKnobValueAsLines("memory.stat", lines);
-    if (error)
-        return error;
+    std::map<std::string, uint64_t> local, *stat = &local;
 
-    for (auto &line : lines) {
-        vector<string> tokens;
-        error = SplitString(line, ' ', tokens);
+    if (StatCache) {
+        auto path = (cg->Path() / "memory.stat").ToString();
+        auto it = StatCache->MemoryStat.find(path);
+        if (it == StatCache->MemoryStat.end()) {
+            TError error = Statistics(cg, local);
+            if (error)
+                return error;
+            it = StatCache->MemoryStat.emplace(path, std::move(local)).first;
+        }
+        stat = &it->second;
+    } else {
+        TError error = Statistics(cg, local);
         if (error)
             return error;
-
-        if (tokens.size() != 2)
-            continue;
-
-        if (tokens[0] == name)
-            return StringToUint64(tokens[1], val);
     }
 
-    return TError(EError::InvalidValue, "Invalid memory cgroup stat: " + name);
+    auto it = stat->find(name);
+    if (it == stat->end())
+        return TError(EError::InvalidValue, "Invalid memory cgroup stat: " + name);
+
+    val = it->second;
+    return TError::Success();
 }
 
 TError TMemorySubsystem::UseHierarchy(std::shared_ptr<TCgroup> cg, bool enable) const {
@@ -179,7 +220,7 @@ TError TMemorySubsystem::SetIoLimit(std::shared_ptr<TCgroup> cg, uint64_t limit)
 TError TFreezerSubsystem::WaitState(std::shared_ptr<TCgroup> cg,
                                     const std::string &state) const {
 
-    int ret = RetryFailed(config().daemon().freezer_wait_timeout_s() * 10, 100, [&]{
+    int ret = RetryBackoff(config().daemon().freezer_wait_timeout_s() * 1000, 100, [&]{
         string s;
         TError error = cg->GetKnobValue("freezer.state", s);
         if (error)
@@ -303,11 +344,7 @@ bool TCpuSubsystem::SupportGuarantee() {
 
 // Cpuacct
 TError TCpuacctSubsystem::Usage(shared_ptr<TCgroup> cg, uint64_t &value) const {
-    string s;
-    TError error = cg->GetKnobValue("cpuacct.usage", s);
-    if (error)
-        return error;
-    return StringToUint64(s, value);
+    return cg->GetKnobValue("cpuacct.usage", value);
 }
 
 // Netcls
@@ -331,6 +368,19 @@ TError TBlkioSubsystem::GetStatLine(const vector<string> &lines,
 
 TError TBlkioSubsystem::GetDevice(const std::string &majmin,
                                   std::string &device) const {
+    // block devices are rarely renamed, don't read uevent on each sample
+    static std::mutex devicesLock;
+    static std::map<std::string, std::string> devices;
+
+    {
+        std::lock_guard<std::mutex> lock(devicesLock);
+        auto it = devices.find(majmin);
+        if (it != devices.end()) {
+            device = it->second;
+            return TError::Success();
+        }
+    }
+
     TFile f("/sys/dev/block/" + majmin + "/uevent");
     vector<string> lines;
     TError error = f.AsLines(lines);
@@ -348,6 +398,8 @@ TError TBlkioSubsystem::GetDevice(const std::string &majmin,
 
         if (tokens[0] == "DEVNAME") {
             device = tokens[1];
+            std::lock_guard<std::mutex> lock(devicesLock);
+            devices[majmin] = device;
             return TError::Success();
         }
     }
@@ -355,13 +407,9 @@ TError TBlkioSubsystem::GetDevice(const std::string &majmin,
     return TError(EError::Unknown, "Unable to convert device maj+min to name");
 }
 
-TError TBlkioSubsystem::Statistics(std::shared_ptr<TCgroup> cg,
-                                   const std::string &file,
-                                   std::vector<BlkioStat> &stat) const {
-    vector<string> lines;
-    TError error = cg->GetKnobValueAsLines(file, lines);
-    if (error)
-        return error;
+TError TBlkioSubsystem::ParseStatistics(const std::vector<std::string> &lines,
+                                        std::vector<BlkioStat> &stat) const {
+    TError error;
 
     BlkioStat s;
     for (size_t i = 0; i < lines.size(); i += 5) {
@@ -397,6 +445,35 @@ TError TBlkioSubsystem::Statistics(std::shared_ptr<TCgroup> cg,
     return TError::Success();
 }
 
+TError TBlkioSubsystem::Statistics(std::shared_ptr<TCgroup> cg,
+                                   const std::string &file,
+                                   std::vector<BlkioStat> &stat) const {
+    std::string path;
+
+    if (StatCache) {
+        path = (cg->Path() / file).ToString();
+        auto it = StatCache->Blkio.find(path);
+        if (it != StatCache->Blkio.end()) {
+            stat = it->second;
+            return TError::Success();
+        }
+    }
+
+    vector<string> lines;
+    TError error = cg->GetKnobValueAsLines(file, lines);
+    if (error)
+        return error;
+
+    error = ParseStatistics(lines, stat);
+    if (error)
+        return error;
+
+    if (StatCache)
+        StatCache->Blkio[path] = stat;
+
+    return TError::Success();
+}
+
 TError TBlkioSubsystem::SetPolicy(std::shared_ptr<TCgroup> cg, bool batch) {
     if (!SupportPolicy())
         return TError::Success();
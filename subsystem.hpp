@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <vector>
 
 #include "common.hpp"
 
@@ -24,10 +25,21 @@ public:
     std::shared_ptr<TCgroup> GetRootCgroup(std::shared_ptr<TMount> mount=nullptr);
 };
 
+// While exists cgroup statistics files are read and parsed by current
+// thread only once, for example for all data of one request.
+class TCgroupStatScope : public TNonCopyable {
+    bool Owner;
+public:
+    TCgroupStatScope();
+    ~TCgroupStatScope();
+};
+
 class TMemorySubsystem : public TSubsystem {
 public:
     TMemorySubsystem() : TSubsystem("memory") {}
     TError Usage(std::shared_ptr<TCgroup> cg, uint64_t &value) const;
+    TError Statistics(std::shared_ptr<TCgroup> cg,
+                      std::map<std::string, uint64_t> &stat) const;
     TError Statistics(std::shared_ptr<TCgroup> cg,
                       const std::string &name,
                       uint64_t &val) const;
@@ -100,6 +112,8 @@ public:
     TError Statistics(std::shared_ptr<TCgroup> cg,
                       const std::string &file,
                       std::vector<BlkioStat> &stat) const;
+    TError ParseStatistics(const std::vector<std::string> &lines,
+                           std::vector<BlkioStat> &stat) const;
     TError SetPolicy(std::shared_ptr<TCgroup> cg, bool batch);
     bool SupportPolicy();
 };
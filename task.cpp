@@ -7,6 +7,8 @@
 #include "config.hpp"
 #include "cgroup.hpp"
 #include "subsystem.hpp"
+#include "statistics.hpp"
+#include "spawn.pb.h"
 #include "util/log.hpp"
 #include "util/mount.hpp"
 #include "util/folder.hpp"
@@ -24,6 +26,9 @@ extern "C" {
 #include <sys/wait.h>
 #include <sys/prctl.h>
 #include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/signalfd.h>
+#include <poll.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <wordexp.h>
@@ -846,142 +851,161 @@ TError TTask::CreateCwd() {
     return CreateTmpDir(Env->Cwd, Cwd);
 }
 
-TError TTask::Start() {
-    int ret;
-    int pfd[2], syncfd[2];
+void TTask::Spawn() {
+    TError error;
+    int syncfd[2];
 
-    Pid = 0;
+    SetProcessName("portod-spawn-p");
 
-    if (Env->CreateCwd) {
-        TError error = CreateCwd();
+    char stack[8192];
+
+    (void)setsid();
+
+    // move to target cgroups
+    for (auto cg : Env->LeafCgroups) {
+        error = cg.second->Attach(getpid());
         if (error) {
-            if (error.GetError() != EError::NoSpace)
-                L_ERR() << "Can't create temporary cwd: " << error << std::endl;
-            return error;
+            L() << "Can't attach to cgroup: " << error << std::endl;
+            ReportPid(-1);
+            Abort(error);
         }
     }
 
-    ExitStatus = 0;
+    for (auto &path : Env->CgroupPaths) {
+        error = TFile(path / "cgroup.procs").AppendString(std::to_string(getpid()));
+        if (error) {
+            L() << "Can't attach to cgroup " << path << ": " << error << std::endl;
+            ReportPid(-1);
+            Abort(error);
+        }
+    }
 
-    ret = pipe2(pfd, O_CLOEXEC);
-    if (ret) {
-        TError error(EError::Unknown, errno, "pipe2(pdf)");
-        L_ERR() << "Can't create communication pipe for child: " << error << std::endl;
-        return error;
+    error = Env->ClientMntNs.SetNs();
+    if (error) {
+        L() << "Can't move task to client mount namespace: " << error << std::endl;
+        ReportPid(-1);
+        Abort(error);
     }
 
-    Rfd = pfd[0];
-    Wfd = pfd[1];
+    error = ReopenStdio();
+    if (error) {
+        ReportPid(-1);
+        Abort(error);
+    }
 
-    // we want our child to have portod master as parent, so we
-    // are doing double fork here (fork + clone);
-    // we also need to know child pid so we are using pipe to send it back
+    error = Env->ParentNs.Enter();
+    if (error) {
+        L() << "Cannot enter namespaces: " << error << std::endl;
+        ReportPid(-1);
+        Abort(error);
+    }
 
-    pid_t forkPid = fork();
-    if (forkPid < 0) {
-        TError error(EError::Unknown, errno, "fork()");
-        L() << "Can't spawn child: " << error << std::endl;
-        close(Rfd);
-        close(Wfd);
-        return error;
-    } else if (forkPid == 0) {
-        TError error;
+    int cloneFlags = SIGCHLD;
+    if (Env->Isolate)
+        cloneFlags |= CLONE_NEWPID | CLONE_NEWIPC;
 
-        SetDieOnParentExit(SIGKILL);
-        SetProcessName("portod-spawn-p");
+    if (Env->NewMountNs)
+        cloneFlags |= CLONE_NEWNS;
 
-        char stack[8192];
+    if (!Env->Hostname.empty())
+        cloneFlags |= CLONE_NEWUTS;
 
-        (void)setsid();
+    if (Env->NetCfg.NewNetNs)
+        cloneFlags |= CLONE_NEWNET;
 
-        // move to target cgroups
-        for (auto cg : Env->LeafCgroups) {
-            error = cg.second->Attach(getpid());
-            if (error) {
-                L() << "Can't attach to cgroup: " << error << std::endl;
-                ReportPid(-1);
-                Abort(error);
-            }
-        }
+    int ret = pipe2(syncfd, O_CLOEXEC);
+    if (ret) {
+        TError error(EError::Unknown, errno, "pipe2(pdf)");
+        L() << "Can't create sync pipe for child: " << error << std::endl;
+        ReportPid(-1);
+        Abort(error);
+    }
 
-        error = Env->ClientMntNs.SetNs();
-        if (error) {
-            L() << "Can't move task to client mount namespace: " << error << std::endl;
-            ReportPid(-1);
-            Abort(error);
-        }
+    WaitParentRfd = syncfd[0];
+    WaitParentWfd = syncfd[1];
 
-        error = ReopenStdio();
-        if (error) {
-            ReportPid(-1);
-            Abort(error);
-        }
+    pid_t clonePid = clone(ChildFn, stack + sizeof(stack), cloneFlags, this);
+    close(WaitParentRfd);
+    ReportPid(clonePid);
+    if (clonePid < 0) {
+        TError error(errno == ENOMEM ?
+                     EError::ResourceNotAvailable :
+                     EError::Unknown, errno, "clone()");
+        L() << "Can't spawn child: " << error << std::endl;
+        Abort(error);
+    }
 
-        error = Env->ParentNs.Enter();
+    if (config().network().enabled()) {
+        error = IsolateNet(clonePid);
         if (error) {
-            L() << "Cannot enter namespaces: " << error << std::endl;
-            ReportPid(-1);
+            L() << "Can't isolate child network: " << error << std::endl;
             Abort(error);
         }
+    }
 
-        int cloneFlags = SIGCHLD;
-        if (Env->Isolate)
-            cloneFlags |= CLONE_NEWPID | CLONE_NEWIPC;
+    int result = 0;
+    ret = write(WaitParentWfd, &result, sizeof(result));
+    if (ret != sizeof(result)) {
+        TError error(EError::Unknown, "Partial write to child sync pipe (" + std::to_string(ret) + " != " + std::to_string(result) + ")");
+        L() << "Can't spawn child: " << error << std::endl;
+        Abort(error);
+    }
 
-        if (Env->NewMountNs)
-            cloneFlags |= CLONE_NEWNS;
+    _exit(EXIT_SUCCESS);
+}
 
-        if (!Env->Hostname.empty())
-            cloneFlags |= CLONE_NEWUTS;
+TError TTask::Start() {
+    int ret;
+    int pfd[2];
 
-        if (Env->NetCfg.NewNetNs)
-            cloneFlags |= CLONE_NEWNET;
+    Pid = 0;
 
-        int ret = pipe2(syncfd, O_CLOEXEC);
-        if (ret) {
-            TError error(EError::Unknown, errno, "pipe2(pdf)");
-            L() << "Can't create sync pipe for child: " << error << std::endl;
-            ReportPid(-1);
-            Abort(error);
+    if (Env->CreateCwd) {
+        TError error = CreateCwd();
+        if (error) {
+            if (error.GetError() != EError::NoSpace)
+                L_ERR() << "Can't create temporary cwd: " << error << std::endl;
+            return error;
         }
+    }
 
-        WaitParentRfd = syncfd[0];
-        WaitParentWfd = syncfd[1];
+    ExitStatus = 0;
 
-        pid_t clonePid = clone(ChildFn, stack + sizeof(stack), cloneFlags, this);
-        close(WaitParentRfd);
-        ReportPid(clonePid);
-        if (clonePid < 0) {
-            TError error(errno == ENOMEM ?
-                         EError::ResourceNotAvailable :
-                         EError::Unknown, errno, "clone()");
-            L() << "Can't spawn child: " << error << std::endl;
-            Abort(error);
-        }
+    ret = pipe2(pfd, O_CLOEXEC);
+    if (ret) {
+        TError error(EError::Unknown, errno, "pipe2(pdf)");
+        L_ERR() << "Can't create communication pipe for child: " << error << std::endl;
+        return error;
+    }
 
-        if (config().network().enabled()) {
-            error = IsolateNet(clonePid);
-            if (error) {
-                L() << "Can't isolate child network: " << error << std::endl;
-                Abort(error);
-            }
-        }
+    Rfd = pfd[0];
+    Wfd = pfd[1];
 
-        int result = 0;
-        ret = write(WaitParentWfd, &result, sizeof(result));
-        if (ret != sizeof(result)) {
-            TError error(EError::Unknown, "Partial write to child sync pipe (" + std::to_string(ret) + " != " + std::to_string(result) + ")");
+    int status = 0;
+
+    if (TaskSpawner.Spawn(*Env, Wfd, status)) {
+        close(Wfd);
+    } else {
+        // we want our child to have portod master as parent, so we
+        // are doing double fork here (fork + clone);
+        // we also need to know child pid so we are using pipe to send it back
+
+        pid_t forkPid = fork();
+        if (forkPid < 0) {
+            TError error(EError::Unknown, errno, "fork()");
             L() << "Can't spawn child: " << error << std::endl;
-            Abort(error);
+            close(Rfd);
+            close(Wfd);
+            return error;
+        } else if (forkPid == 0) {
+            SetDieOnParentExit(SIGKILL);
+            Spawn();
         }
-
-        _exit(EXIT_SUCCESS);
+        close(Wfd);
+        int forkResult = waitpid(forkPid, &status, 0);
+        if (forkResult < 0)
+            (void)kill(forkPid, SIGKILL);
     }
-    close(Wfd);
-    int status = 0;
-    int forkResult = waitpid(forkPid, &status, 0);
-    if (forkResult < 0)
-        (void)kill(forkPid, SIGKILL);
 
     int n = read(Rfd, &Pid, sizeof(Pid));
     if (n <= 0) {
@@ -1178,3 +1202,478 @@ TError TaskGetLastCap() {
     TFile f("/proc/sys/kernel/cap_last_cap");
     return f.AsInt(lastCap);
 }
+
+// TTaskSpawner
+
+TTaskSpawner TaskSpawner;
+
+// environment is small unless somebody passes huge command or env
+static const size_t MAX_SPAWN_MESSAGE = 64 << 10;
+
+// bit of spawn::TTaskEnv::ns_fds for log descriptor, others are namespaces
+static const int SPAWN_LOG_FD = 8;
+
+// Descriptors are passed in the same order: write end of result pipe,
+// then opened namespaces of ParentNs and ClientMntNs, then log.
+static void EncodeTaskEnv(const TTaskEnv &env, spawn::TTaskEnv &msg,
+                          std::vector<int> &fds) {
+    msg.set_command(env.Command);
+    msg.set_cwd(env.Cwd.ToString());
+    msg.set_root(env.Root.ToString());
+    msg.set_root_rdonly(env.RootRdOnly);
+    for (auto &var : env.Environ)
+        msg.add_environ(var);
+    msg.set_isolate(env.Isolate);
+    msg.set_stdin_path(env.StdinPath.ToString());
+    msg.set_stdout_path(env.StdoutPath.ToString());
+    msg.set_stderr_path(env.StderrPath.ToString());
+
+    for (auto &it : env.Rlimit) {
+        auto rlim = msg.add_rlimit();
+        rlim->set_resource(it.first);
+        rlim->set_cur(it.second.rlim_cur);
+        rlim->set_max(it.second.rlim_max);
+    }
+
+    msg.set_hostname(env.Hostname);
+    msg.set_bind_dns(env.BindDns);
+
+    for (auto &bm : env.BindMap) {
+        auto bind = msg.add_bind_map();
+        bind->set_source(bm.Source.ToString());
+        bind->set_dest(bm.Dest.ToString());
+        bind->set_rdonly(bm.Rdonly);
+    }
+
+    msg.set_new_net_ns(env.NetCfg.NewNetNs);
+
+    for (auto &host : env.NetCfg.HostIface)
+        msg.add_host_iface()->set_dev(host.Dev);
+
+    for (auto &mvlan : env.NetCfg.MacVlan) {
+        auto link = msg.add_macvlan();
+        link->set_master(mvlan.Master);
+        link->set_name(mvlan.Name);
+        link->set_type(mvlan.Type);
+        link->set_hw(mvlan.Hw);
+        link->set_mtu(mvlan.Mtu);
+    }
+
+    for (auto &ipvlan : env.NetCfg.IpVlan) {
+        auto link = msg.add_ipvlan();
+        link->set_master(ipvlan.Master);
+        link->set_name(ipvlan.Name);
+        link->set_mode(ipvlan.Mode);
+        link->set_mtu(ipvlan.Mtu);
+    }
+
+    for (auto &veth : env.NetCfg.Veth) {
+        auto link = msg.add_veth();
+        link->set_bridge(veth.Bridge);
+        link->set_name(veth.Name);
+        link->set_hw(veth.Hw);
+        link->set_peer(veth.Peer);
+        link->set_mtu(veth.Mtu);
+    }
+
+    if (!env.Loop.IsEmpty()) {
+        msg.set_loop(env.Loop.ToString());
+        msg.set_loop_dev(env.LoopDev);
+    }
+
+    msg.set_caps(env.Caps);
+
+    for (auto &ip : env.IpVec) {
+        auto addr = msg.add_ip();
+        addr->set_iface(ip.Iface);
+        addr->set_addr(ip.Addr.IsEmpty() ? "" : ip.Addr.Format());
+        addr->set_prefix(ip.Prefix);
+    }
+
+    for (auto &gw : env.GwVec) {
+        auto addr = msg.add_gw();
+        addr->set_iface(gw.Iface);
+        addr->set_addr(gw.Addr.IsEmpty() ? "" : gw.Addr.Format());
+    }
+
+    msg.set_new_mount_ns(env.NewMountNs);
+
+    for (auto &it : env.LeafCgroups)
+        msg.add_cgroup(it.second->Path().ToString());
+
+    msg.set_uid(env.Cred.Uid);
+    msg.set_gid(env.Cred.Gid);
+
+    if (env.GroupList) {
+        auto gid = (const gid_t *)env.GroupList->GetData();
+        for (size_t i = 0; i < env.GroupList->GetSize() / sizeof(gid_t); i++)
+            msg.add_groups(gid[i]);
+    }
+
+    const TNamespaceFd *ns[] = {
+        &env.ParentNs.Ipc, &env.ParentNs.Uts, &env.ParentNs.Net,
+        &env.ParentNs.Pid, &env.ParentNs.Mnt, &env.ParentNs.Root,
+        &env.ParentNs.Cwd, &env.ClientMntNs,
+    };
+
+    uint32_t mask = 0;
+    for (int i = 0; i < SPAWN_LOG_FD; i++) {
+        if (ns[i]->IsOpened()) {
+            mask |= 1 << i;
+            fds.push_back(ns[i]->GetFd());
+        }
+    }
+
+    if (TLogger::GetFd() >= 0) {
+        mask |= 1 << SPAWN_LOG_FD;
+        fds.push_back(TLogger::GetFd());
+    }
+
+    msg.set_ns_fds(mask);
+}
+
+// Takes ownership of namespace descriptors, log descriptor is returned
+static TError DecodeTaskEnv(const spawn::TTaskEnv &msg, const std::vector<int> &fds,
+                            TTaskEnv &env, int &logFd) {
+    TError error;
+
+    size_t nr = 1 + __builtin_popcount(msg.ns_fds());
+    if (fds.size() != nr)
+        return TError(EError::Unknown, "Expected " + std::to_string(nr) +
+                      " descriptors, got " + std::to_string(fds.size()));
+
+    env.Command = msg.command();
+    env.Cwd = msg.cwd();
+    env.CreateCwd = false;
+    env.Root = msg.root();
+    env.RootRdOnly = msg.root_rdonly();
+    for (auto &var : msg.environ())
+        env.Environ.push_back(var);
+    env.Isolate = msg.isolate();
+    env.StdinPath = msg.stdin_path();
+    env.StdoutPath = msg.stdout_path();
+    env.StderrPath = msg.stderr_path();
+
+    for (auto &rlim : msg.rlimit()) {
+        env.Rlimit[rlim.resource()].rlim_cur = rlim.cur();
+        env.Rlimit[rlim.resource()].rlim_max = rlim.max();
+    }
+
+    env.Hostname = msg.hostname();
+    env.BindDns = msg.bind_dns();
+
+    for (auto &bind : msg.bind_map())
+        env.BindMap.push_back({ bind.source(), bind.dest(), bind.rdonly() });
+
+    env.NetCfg.Clear();
+    env.NetCfg.NewNetNs = msg.new_net_ns();
+
+    for (auto &link : msg.host_iface())
+        env.NetCfg.HostIface.push_back({ link.dev() });
+
+    for (auto &link : msg.macvlan())
+        env.NetCfg.MacVlan.push_back({ link.master(), link.name(), link.type(),
+                                       link.hw(), link.mtu() });
+
+    for (auto &link : msg.ipvlan())
+        env.NetCfg.IpVlan.push_back({ link.master(), link.name(), link.mode(),
+                                      link.mtu() });
+
+    for (auto &link : msg.veth())
+        env.NetCfg.Veth.push_back({ link.bridge(), link.name(), link.hw(),
+                                    link.peer(), link.mtu() });
+
+    env.Loop = msg.loop();
+    env.LoopDev = msg.loop_dev();
+    env.Caps = msg.caps();
+
+    for (auto &addr : msg.ip()) {
+        TIpVec ip;
+        ip.Iface = addr.iface();
+        ip.Prefix = addr.prefix();
+        if (!addr.addr().empty()) {
+            error = ip.Addr.Parse(addr.addr());
+            if (error)
+                return error;
+        }
+        env.IpVec.push_back(ip);
+    }
+
+    for (auto &addr : msg.gw()) {
+        TGwVec gw;
+        gw.Iface = addr.iface();
+        if (!addr.addr().empty()) {
+            error = gw.Addr.Parse(addr.addr());
+            if (error)
+                return error;
+        }
+        env.GwVec.push_back(gw);
+    }
+
+    env.NewMountNs = msg.new_mount_ns();
+
+    for (auto &path : msg.cgroup())
+        env.CgroupPaths.push_back(path);
+
+    env.Cred = TCred(msg.uid(), msg.gid());
+
+    env.GroupList = std::unique_ptr<TScopedMem>(
+            new TScopedMem(msg.groups_size() * sizeof(gid_t)));
+    auto gid = (gid_t *)env.GroupList->GetData();
+    for (int i = 0; i < msg.groups_size(); i++)
+        gid[i] = msg.groups(i);
+
+    TNamespaceFd *ns[] = {
+        &env.ParentNs.Ipc, &env.ParentNs.Uts, &env.ParentNs.Net,
+        &env.ParentNs.Pid, &env.ParentNs.Mnt, &env.ParentNs.Root,
+        &env.ParentNs.Cwd, &env.ClientMntNs,
+    };
+
+    size_t next = 1;
+    for (int i = 0; i < SPAWN_LOG_FD; i++)
+        if (msg.ns_fds() & (1 << i))
+            ns[i]->SetFd(fds[next++]);
+
+    logFd = (msg.ns_fds() & (1 << SPAWN_LOG_FD)) ? fds[next] : -1;
+
+    return TError::Success();
+}
+
+TError TTaskSpawner::Start() {
+    int sfd[2];
+
+    TError error = TaskGetLastCap();
+    if (error)
+        return error;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sfd) < 0)
+        return TError(EError::Unknown, errno, "socketpair()");
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        error = TError(EError::Unknown, errno, "fork()");
+        close(sfd[0]);
+        close(sfd[1]);
+        return error;
+    }
+
+    if (pid == 0) {
+        SetDieOnParentExit(SIGKILL);
+        SetProcessName("portod-spawner");
+
+        Sock = sfd[1];
+        CloseFds(-1, { Sock, TLogger::GetFd() }, true);
+        Serve();
+    }
+
+    close(sfd[1]);
+    Sock = sfd[0];
+    Pid = pid;
+
+    L_SYS() << "Started task spawner " << Pid << std::endl;
+
+    return TError::Success();
+}
+
+// Sent back by spawner when spawn helper exits
+struct TSpawnReply {
+    uint64_t Seq;
+    int Status;
+};
+
+static void SendSpawnReply(int sock, uint64_t seq, int status) {
+    TSpawnReply reply = { seq, status };
+
+    if (send(sock, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply))
+        _exit(EXIT_FAILURE);
+}
+
+void TTaskSpawner::Serve() {
+    // spawn helper -> sequence number of its request
+    std::map<pid_t, uint64_t> helpers;
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    (void)sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+    int sigFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sigFd < 0) {
+        L_ERR() << "Can't create signalfd for task spawner: " << strerror(errno) << std::endl;
+        _exit(EXIT_FAILURE);
+    }
+
+    while (true) {
+        struct pollfd pfd[2] = { { Sock, POLLIN, 0 }, { sigFd, POLLIN, 0 } };
+
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            L_ERR() << "Task spawner poll: " << strerror(errno) << std::endl;
+            _exit(EXIT_FAILURE);
+        }
+
+        if (pfd[1].revents) {
+            struct signalfd_siginfo info;
+            while (read(sigFd, &info, sizeof(info)) == sizeof(info)) {}
+
+            int status;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                auto it = helpers.find(pid);
+                if (it == helpers.end())
+                    continue;
+                SendSpawnReply(Sock, it->second, status);
+                helpers.erase(it);
+            }
+        }
+
+        if (!pfd[0].revents)
+            continue;
+
+        std::vector<int> fds;
+        std::string data;
+
+        TError error = RecvMessage(Sock, data, MAX_SPAWN_MESSAGE, fds, true);
+        if (error) {
+            L() << "Task spawner stopped: " << error << std::endl;
+            _exit(EXIT_SUCCESS);
+        }
+
+        // nothing except result pipe should leak into the task
+        for (auto fd : fds)
+            (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+        // without sequence number reply cannot be matched
+        spawn::TTaskEnv msg;
+        if (!msg.ParseFromString(data) || fds.empty()) {
+            L_ERR() << "Can't parse task environment" << std::endl;
+            _exit(EXIT_FAILURE);
+        }
+
+        auto env = std::make_shared<TTaskEnv>();
+        int logFd = -1;
+
+        error = DecodeTaskEnv(msg, fds, *env, logFd);
+        if (error) {
+            for (size_t i = 1; i < fds.size(); i++)
+                close(fds[i]);
+        }
+
+        // log could be reopened by slave since last task
+        if (logFd >= 0) {
+            if (TLogger::GetFd() > 2)
+                (void)dup3(logFd, TLogger::GetFd(), O_CLOEXEC);
+            close(logFd);
+        }
+
+        if (!error) {
+            TTask task(env);
+
+            task.Rfd = -1;
+            task.Wfd = fds[0];
+
+            pid_t pid = fork();
+            if (pid < 0) {
+                error = TError(EError::Unknown, errno, "fork()");
+            } else if (pid == 0) {
+                SetDieOnParentExit(SIGKILL);
+                (void)sigprocmask(SIG_UNBLOCK, &mask, nullptr);
+                close(sigFd);
+                close(Sock);
+                task.Spawn();
+            } else {
+                helpers[pid] = msg.seq();
+            }
+        }
+
+        close(fds[0]);
+
+        if (error) {
+            L_ERR() << "Can't spawn task: " << error << std::endl;
+            SendSpawnReply(Sock, msg.seq(), -1);
+        }
+    }
+}
+
+void TTaskSpawner::Shutdown() {
+    // waiter reading replies will get EOF and finish shutdown
+    if (Reading) {
+        (void)kill(Pid, SIGKILL);
+        return;
+    }
+
+    close(Sock);
+    Sock = -1;
+
+    (void)kill(Pid, SIGKILL);
+    (void)waitpid(Pid, nullptr, 0);
+    Pid = 0;
+
+    Replied.notify_all();
+}
+
+bool TTaskSpawner::Spawn(const TTaskEnv &env, int wfd, int &status) {
+    spawn::TTaskEnv msg;
+    std::vector<int> fds = { wfd };
+    EncodeTaskEnv(env, msg, fds);
+
+    auto lock = ScopedLock();
+
+    if (Sock < 0)
+        return false;
+
+    uint64_t seq = ++Seq;
+    msg.set_seq(seq);
+
+    std::string data;
+    if (!msg.SerializeToString(&data) || data.size() > MAX_SPAWN_MESSAGE)
+        return false;
+
+    TError error = SendMessage(Sock, data, fds, true);
+    if (error) {
+        L_ERR() << "Can't pass task to spawner: " << error << std::endl;
+        Shutdown();
+        return false;
+    }
+
+    Statistics->SpawnerTasks++;
+
+    while (!Replies.count(seq)) {
+        if (Sock < 0) {
+            status = -1;
+            return true;
+        }
+
+        if (Reading) {
+            Replied.wait(lock);
+            continue;
+        }
+
+        Reading = true;
+        int sock = Sock;
+        lock.unlock();
+
+        TSpawnReply reply;
+        ssize_t ret;
+        do
+            ret = recv(sock, &reply, sizeof(reply), 0);
+        while (ret < 0 && errno == EINTR);
+
+        lock.lock();
+        Reading = false;
+
+        if (ret != sizeof(reply)) {
+            L_ERR() << "Task spawner doesn't respond: " << strerror(errno) << std::endl;
+            Shutdown();
+        } else {
+            Replies[reply.Seq] = reply.Status;
+            Replied.notify_all();
+        }
+    }
+
+    status = Replies[seq];
+    Replies.erase(seq);
+
+    return true;
+}
@@ -4,11 +4,14 @@
 #include <vector>
 #include <cstdint>
 #include <memory>
+#include <map>
+#include <condition_variable>
 
 #include "util/namespace.hpp"
 #include "util/path.hpp"
 #include "util/netlink.hpp"
 #include "util/cred.hpp"
+#include "util/locks.hpp"
 
 extern "C" {
 #include <sys/resource.h>
@@ -121,6 +124,8 @@ struct TTaskEnv : public TNonCopyable {
     std::vector<TIpVec> IpVec;
     bool NewMountNs;
     std::map<std::shared_ptr<TSubsystem>, std::shared_ptr<TCgroup>> LeafCgroups;
+    // used by spawner instead of LeafCgroups
+    std::vector<TPath> CgroupPaths;
     std::unique_ptr<TScopedMem> GroupList;
     TCred Cred;
 
@@ -142,6 +147,7 @@ class TTask: public TNonCopyable {
     std::shared_ptr<TFolder> Cwd;
 
     void ReportPid(int pid) const;
+    void Spawn();
 
     TError ReopenStdio();
     TError IsolateNet(int childPid);
@@ -162,6 +168,8 @@ class TTask: public TNonCopyable {
     TError ChildIsolateFs();
     TError ChildEnableNet();
 
+    friend class TTaskSpawner;
+
 public:
     TTask(std::shared_ptr<const TTaskEnv> env) : Env(env) {};
     TTask(pid_t pid) : Pid(pid) {};
@@ -193,3 +201,28 @@ public:
 };
 
 TError TaskGetLastCap();
+
+// Small single-threaded process forked by slave at start: it gets
+// environment of each task over socket and does fork and clone itself,
+// so starting task doesn't copy whole slave with all its threads
+class TTaskSpawner : public TLockable, public TNonCopyable {
+    int Sock = -1;
+    pid_t Pid = 0;
+
+    // Tasks are spawned concurrently, replies are matched by sequence
+    // number and read by one of waiters at a time
+    uint64_t Seq = 0;
+    std::map<uint64_t, int> Replies;
+    bool Reading = false;
+    std::condition_variable Replied;
+
+    void Serve();
+    void Shutdown();
+public:
+    TError Start();
+    // Returns false if task must be started by forking slave instead,
+    // otherwise status is wait status of spawn helper as in fork path
+    bool Spawn(const TTaskEnv &env, int wfd, int &status);
+};
+
+extern TTaskSpawner TaskSpawner;
@@ -0,0 +1,314 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <malloc.h>
+
+#include <google/protobuf/arena.h>
+
+#include "rpc.pb.h"
+#include "config.hpp"
+#include "value.hpp"
+#include "util/unix.hpp"
+#include "test.hpp"
+
+using std::string;
+using std::pair;
+
+namespace test {
+
+static void Report(const std::string &what, size_t nr, size_t ms) {
+    Say() << what << ": " << nr << " in " << ms / 1000.0 << "s, "
+          << (ms ? nr * 1000 / ms : nr) << "/s" << std::endl;
+}
+
+static void BenchExit(TPortoAPI &api, int nr) {
+    const int idleNr = 1000;
+    std::vector<std::string> idle, tasks;
+    std::string name;
+
+    // exit delivery used to scan every container, so make sure there
+    // are plenty of them which don't have any task at all
+    for (int i = 0; i < idleNr; i++) {
+        name = "bench_idle" + std::to_string(i);
+        ExpectApiSuccess(api.Create(name));
+        idle.push_back(name);
+    }
+
+    for (int i = 0; i < nr; i++) {
+        name = "bench_exit" + std::to_string(i);
+        ExpectApiSuccess(api.Create(name));
+        ExpectApiSuccess(api.SetProperty(name, "command", "true"));
+        tasks.push_back(name);
+    }
+
+    size_t begin = GetCurrentTimeMs();
+
+    for (auto &n : tasks)
+        ExpectApiSuccess(api.Start(n));
+
+    std::vector<std::string> running = tasks;
+    while (running.size()) {
+        ExpectApiSuccess(api.Wait(running, name));
+        running.erase(std::remove(running.begin(), running.end(), name),
+                      running.end());
+    }
+
+    size_t ms = GetCurrentTimeMs() - begin;
+    Report("Start and exit with " + std::to_string(idleNr) + " idle containers",
+           nr, ms);
+
+    for (auto &n : tasks) {
+        std::string v;
+        ExpectApiSuccess(api.GetData(n, "state", v));
+        ExpectEq(v, "dead");
+        ExpectApiSuccess(api.Destroy(n));
+    }
+
+    for (auto &n : idle)
+        ExpectApiSuccess(api.Destroy(n));
+}
+
+// Starts tasks from several clients at once, like container workers do
+static size_t StartTasks(TPortoAPI &api, const std::vector<std::string> &tasks) {
+    const size_t clientsNr = 4;
+    std::atomic<int> failed(0);
+    std::vector<std::thread> clients;
+    std::string name;
+
+    size_t begin = GetCurrentTimeMs();
+
+    for (size_t c = 0; c < clientsNr; c++) {
+        clients.emplace_back([&tasks, &failed, c, clientsNr]() {
+            TPortoAPI client(config().rpc_sock().file().path(), 0);
+            for (size_t i = c; i < tasks.size(); i += clientsNr)
+                if (client.Start(tasks[i]))
+                    failed++;
+        });
+    }
+
+    for (auto &client : clients)
+        client.join();
+
+    size_t ms = GetCurrentTimeMs() - begin;
+    ExpectEq(failed.load(), 0);
+
+    std::vector<std::string> running = tasks;
+    while (running.size()) {
+        ExpectApiSuccess(api.Wait(running, name));
+        running.erase(std::remove(running.begin(), running.end(), name),
+                      running.end());
+    }
+
+    for (auto &n : tasks)
+        ExpectApiSuccess(api.Stop(n));
+
+    return ms;
+}
+
+// Start rate must not depend on size of slave
+static void BenchSpawn(TPortoAPI &api, int nr) {
+    const int idleNr = 1000;
+    std::vector<std::string> idle, tasks;
+    std::string name, v;
+
+    for (int i = 0; i < nr; i++) {
+        name = "bench_spawn" + std::to_string(i);
+        ExpectApiSuccess(api.Create(name));
+        ExpectApiSuccess(api.SetProperty(name, "command", "true"));
+        tasks.push_back(name);
+    }
+
+    std::string slave = std::to_string(ReadPid(config().slave_pid().path()));
+
+    Report("Start with slave rss " + std::to_string(GetVmRss(slave)) + "kb",
+           nr, StartTasks(api, tasks));
+
+    for (int i = 0; i < idleNr; i++) {
+        name = "bench_idle" + std::to_string(i);
+        ExpectApiSuccess(api.Create(name));
+        ExpectApiSuccess(api.SetProperty(name, "command", "true"));
+        idle.push_back(name);
+    }
+
+    Report("Start with slave rss " + std::to_string(GetVmRss(slave)) + "kb",
+           nr, StartTasks(api, tasks));
+
+    ExpectApiSuccess(api.GetData("/", "porto_stat[spawner_tasks]", v));
+    Say() << "Tasks started by spawner: " << v << std::endl;
+
+    for (auto &n : tasks)
+        ExpectApiSuccess(api.Destroy(n));
+
+    for (auto &n : idle)
+        ExpectApiSuccess(api.Destroy(n));
+}
+
+// Response of get for nr containers with 20 variables each
+static void BuildGetResponse(rpc::TContainerResponse &rsp, int nr) {
+    auto get = rsp.mutable_get();
+
+    for (int i = 0; i < nr; i++) {
+        auto entry = get->add_list();
+        entry->set_name("bench" + std::to_string(i));
+
+        for (int j = 0; j < 20; j++) {
+            auto keyval = entry->add_keyval();
+            keyval->set_variable("variable" + std::to_string(j));
+            keyval->set_value(std::to_string(i * j));
+        }
+    }
+
+    rsp.set_error(EError::Success);
+}
+
+// Bytes taken from malloc, counted without replacing global operator new
+static int64_t HeapInUse() {
+#if __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 mi = mallinfo2();
+#else
+    struct mallinfo mi = mallinfo();
+#endif
+    return (int64_t)mi.uordblks + (int64_t)mi.hblkhd;
+}
+
+static int ArenaBlocks;
+
+static void *AllocArenaBlock(size_t size) {
+    ArenaBlocks++;
+    return malloc(size);
+}
+
+static void FreeArenaBlock(void *ptr, size_t size) {
+    free(ptr);
+}
+
+static void BenchAlloc(TPortoAPI &api, int nr) {
+    const int rounds = 10;
+    int64_t heapBytes = 0, arenaBytes = 0;
+    uint64_t firstSpace = 0;
+    std::string buf;
+
+    size_t begin = GetCurrentTimeMs();
+
+    for (int i = 0; i < rounds; i++) {
+        rpc::TContainerResponse rsp;
+        int64_t before = HeapInUse();
+        BuildGetResponse(rsp, nr);
+        heapBytes += HeapInUse() - before;
+        rsp.SerializeToString(&buf);
+    }
+
+    Report("Get response for " + std::to_string(nr) + " containers on heap",
+           rounds, GetCurrentTimeMs() - begin);
+
+    // same setup as in rpc workers
+    const size_t blockSize = 256 * 1024;
+    std::unique_ptr<char[]> block(new char[blockSize]);
+    google::protobuf::ArenaOptions options;
+    options.initial_block = block.get();
+    options.initial_block_size = blockSize;
+    options.block_alloc = AllocArenaBlock;
+    options.block_dealloc = FreeArenaBlock;
+    google::protobuf::Arena arena(options);
+
+    ArenaBlocks = 0;
+    begin = GetCurrentTimeMs();
+
+    for (int i = 0; i < rounds; i++) {
+        int64_t before = HeapInUse();
+        auto rsp = google::protobuf::Arena::CreateMessage<rpc::TContainerResponse>(&arena);
+        BuildGetResponse(*rsp, nr);
+        arenaBytes += HeapInUse() - before;
+        rsp->SerializeToString(&buf);
+
+        // reset must give all memory back, every round takes the same
+        uint64_t space = arena.Reset();
+        if (!i)
+            firstSpace = space;
+        ExpectEq(space, firstSpace);
+    }
+
+    Report("Get response for " + std::to_string(nr) + " containers in arena",
+           rounds, GetCurrentTimeMs() - begin);
+
+    Say() << "Heap bytes per response: " << heapBytes / rounds << " on heap, "
+          << arenaBytes / rounds << " in arena" << std::endl;
+    Say() << "Arena blocks per response: " << ArenaBlocks / rounds << std::endl;
+    Say() << "Arena space per response: " << firstSpace << " bytes" << std::endl;
+
+    // sanitizers keep their own allocator and report nothing
+    if (heapBytes > 0)
+        Expect(arenaBytes < heapBytes);
+}
+
+// Same layout as container properties: few dozens of values, some unset
+static void BenchProperty(TPortoAPI &api, int nr) {
+    const int valuesNr = 46;
+    const size_t reads = nr * 10000;
+    TValueTable table;
+    std::vector<std::string> names;
+    std::vector<TValueKey<uint64_t>> keys;
+
+    for (int i = 0; i < valuesNr; i++)
+        names.push_back("value" + std::to_string(i));
+
+    for (int i = 0; i < valuesNr; i++) {
+        keys.push_back(TValueKey<uint64_t>{ i, names[i].c_str() });
+        table.Add(keys[i], new TUintValue(0));
+    }
+
+    TValueMap map(nullptr);
+    map.SetTable(table);
+    for (int i = 0; i < valuesNr; i += 2)
+        ExpectSuccess(map.Set(keys[i], (uint64_t)i + 1));
+
+    uint64_t sum = 0;
+    size_t begin = GetCurrentTimeMs();
+
+    for (size_t i = 0; i < reads; i++)
+        sum += map.Get<uint64_t>(names[i % valuesNr]);
+
+    Report("Property reads by name", reads, GetCurrentTimeMs() - begin);
+
+    uint64_t keySum = 0;
+    begin = GetCurrentTimeMs();
+
+    for (size_t i = 0; i < reads; i++)
+        keySum += map.Get(keys[i % valuesNr]);
+
+    Report("Property reads by typed key", reads, GetCurrentTimeMs() - begin);
+
+    ExpectEq(sum, keySum);
+}
+
+int BenchTest(std::vector<std::string> name, int nr) {
+    pair<string, std::function<void(TPortoAPI &, int)>> tests[] = {
+        { "exit", BenchExit },
+        { "spawn", BenchSpawn },
+        { "alloc", BenchAlloc },
+        { "property", BenchProperty },
+    };
+
+    config.Load();
+    TPortoAPI api(config().rpc_sock().file().path(), 0);
+
+    try {
+        for (auto t : tests) {
+            if (name.size() &&
+                std::find(name.begin(), name.end(), t.first) == name.end())
+                continue;
+
+            std::cerr << ">>> Benchmark " << t.first << "..." << std::endl;
+            t.second(api, nr);
+        }
+    } catch (string e) {
+        std::cerr << "EXCEPTION: " << e << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+}
@@ -3,16 +3,21 @@
 #include <csignal>
 #include <cstdio>
 #include <algorithm>
+#include <set>
 
 #include "version.hpp"
 #include "libporto.hpp"
 #include "config.hpp"
 #include "value.hpp"
+#include "kvalue.hpp"
+#include "kv.pb.h"
+#include "statistics.hpp"
 #include "util/netlink.hpp"
 #include "util/file.hpp"
 #include "util/folder.hpp"
 #include "util/string.hpp"
 #include "util/unix.hpp"
+#include "util/protobuf.hpp"
 #include "util/cred.hpp"
 #include "util/idmap.hpp"
 #include "test.hpp"
@@ -24,6 +29,7 @@ extern "C" {
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <grp.h>
 #include <linux/capability.h>
 }
@@ -434,6 +440,37 @@ static void TestHolder(TPortoAPI &api) {
     ExpectEq(v, "meta");
     ExpectApiSuccess(api.GetData("a", "state", v));
     ExpectEq(v, "meta");
+
+    Say() << "Check filtered list" << std::endl;
+    containers.clear();
+    ExpectApiSuccess(api.List(containers, "a/*"));
+    ExpectEq(containers.size(), 1);
+    ExpectEq(containers[0], string("a/b"));
+
+    containers.clear();
+    ExpectApiSuccess(api.List(containers, "a/***"));
+    ExpectEq(containers.size(), 2);
+    ExpectEq(containers[0], string("a/b"));
+    ExpectEq(containers[1], string("a/b/c"));
+
+    containers.clear();
+    ExpectApiSuccess(api.List(containers, "", "running"));
+    ExpectEq(containers.size(), 1);
+    ExpectEq(containers[0], string("a/b/c"));
+
+    ExpectApiFailure(api.List(containers, "", "invalid"), EError::InvalidValue);
+
+    std::string cursor;
+    containers.clear();
+    ExpectApiSuccess(api.List(containers, "***", "", "", 2, &cursor));
+    ExpectEq(containers.size(), 2);
+    ExpectEq(cursor, string("a"));
+    ExpectApiSuccess(api.List(containers, "***", "", cursor, 2, &cursor));
+    ExpectEq(containers.size(), 4);
+    ExpectEq(containers[2], string("a/b"));
+    ExpectEq(containers[3], string("a/b/c"));
+    ExpectEq(cursor, string(""));
+
     ExpectNeq(GetCgKnob("memory", "a/b/c", "memory.soft_limit_in_bytes"), customLimit);
     ExpectNeq(GetCgKnob("memory", "a/b", "memory.soft_limit_in_bytes"), customLimit);
     ExpectNeq(GetCgKnob("memory", "a", "memory.soft_limit_in_bytes"), customLimit);
@@ -695,6 +732,48 @@ static void TestMeta(TPortoAPI &api) {
 
         ExpectApiSuccess(api.Destroy("a"));
     }
+
+    Say() << "Test sibling subtrees are stopped in parallel" << std::endl;
+    const int childrenNr = 4;
+    ExpectApiSuccess(api.Create("a"));
+    for (int i = 0; i < childrenNr; i++) {
+        std::string name = "a/" + std::to_string(i);
+        ExpectApiSuccess(api.Create(name));
+        // ignore SIGTERM so each stop waits for kill_timeout_ms
+        ExpectApiSuccess(api.SetProperty(name, "command",
+                         "bash -c 'trap \"\" TERM; sleep 1000'"));
+        ExpectApiSuccess(api.Start(name));
+    }
+
+    uint64_t begin = GetCurrentTimeMs();
+    ExpectApiSuccess(api.Stop("a"));
+    uint64_t spent = GetCurrentTimeMs() - begin;
+
+    // one after another they take at least childrenNr * kill_timeout_ms,
+    // in parallel each round of workers takes about kill_timeout_ms
+    if (config().container().stop_threads() > 1 &&
+        config().container().scoped_unlock()) {
+        int workers = std::min<int>(childrenNr, config().container().stop_threads());
+        int rounds = (childrenNr + workers - 1) / workers;
+        Expect(spent < (rounds + 1) * config().container().kill_timeout_ms());
+    }
+
+    for (int i = 0; i < childrenNr; i++) {
+        ExpectApiSuccess(api.GetData("a/" + std::to_string(i), "state", state));
+        ExpectEq(state, "stopped");
+    }
+    ExpectApiSuccess(api.Destroy("a"));
+
+    Say() << "Test destroy of constantly forking container" << std::endl;
+    ExpectApiSuccess(api.Create("a"));
+    ExpectApiSuccess(api.SetProperty("a", "command",
+                     "bash -c 'while true; do /bin/true; done'"));
+    ExpectApiSuccess(api.Start("a"));
+    begin = GetCurrentTimeMs();
+    ExpectApiSuccess(api.Destroy("a"));
+    spent = GetCurrentTimeMs() - begin;
+    Expect(spent < config().container().kill_timeout_ms() + 1000);
+    ExpectApiFailure(api.GetData("a", "state", state), EError::ContainerDoesNotExist);
 }
 
 static void TestEmpty(TPortoAPI &api) {
@@ -3018,6 +3097,13 @@ static void TestData(TPortoAPI &api) {
     Expect(v != "0" && v != "-1");
     ExpectApiSuccess(api.GetData(wget, "memory_usage", v));
     Expect(v != "0" && v != "-1");
+
+    Say() << "Make sure sampled counters are valid" << std::endl;
+    ExpectApiSuccess(api.GetData(wget, "cpu_usage", v, 5000));
+    Expect(v != "0" && v != "-1");
+    ExpectApiSuccess(api.GetData(wget, "memory_usage", v, 5000));
+    Expect(v != "0" && v != "-1");
+
     if (IsCfqActive()) {
         ExpectApiSuccess(api.GetData(wget, "io_write", v));
         ExpectNeq(v, "");
@@ -3700,10 +3786,17 @@ static void TestLimitsHierarchy(TPortoAPI &api) {
     CheckPropertyHierarhcy(api, "memory_guarantee");
     CheckPropertyHierarhcy(api, "memory_limit");
 
+    Say() << "Destroyed child doesn't count in parent guarantee" << std::endl;
+    string slot3 = "box/production/slot3";
+    ExpectApiSuccess(api.Create(slot3));
+    ExpectApiFailure(api.SetProperty(slot3, "memory_guarantee", std::to_string(chunk)), EError::InvalidValue);
+    ExpectApiSuccess(api.Destroy(slot1));
+    ExpectApiSuccess(api.SetProperty(slot3, "memory_guarantee", std::to_string(chunk)));
+    ExpectApiSuccess(api.Destroy(slot3));
+
     ExpectApiSuccess(api.Destroy(monit));
     ExpectApiSuccess(api.Destroy(system));
     ExpectApiSuccess(api.Destroy(slot2));
-    ExpectApiSuccess(api.Destroy(slot1));
     ExpectApiSuccess(api.Destroy(prod));
     ExpectApiSuccess(api.Destroy(box));
 
@@ -4390,6 +4483,135 @@ static void TestVolumeImpl(TPortoAPI &api) {
     ExpectEq(TPath(b).Exists(), false);
 }
 
+static std::string KvValue(std::shared_ptr<TKeyValueNode> node, const std::string &key) {
+    kv::TNode data;
+    std::string val;
+    if (node->Load(data) || TKeyValueStorage::Get(data, key, val))
+        return "";
+    return val;
+}
+
+static kv::TNode KvPair(const std::string &key, const std::string &val) {
+    kv::TNode node;
+    auto pair = node.add_pairs();
+    pair->set_key(key);
+    pair->set_val(val);
+    return node;
+}
+
+static void TestKeyValueStorage(TPortoAPI &api) {
+    TPath dir(TMPDIR + "/kvs");
+    TPath journal = dir / "+journal";
+    std::shared_ptr<TKeyValueStorage> kvs;
+    struct stat st;
+    kv::TNode data;
+
+    // storage runs in this process and updates statistics
+    static TStatistics stats;
+    if (!Statistics)
+        Statistics = &stats;
+
+    auto reopen = [&](uint64_t compactRecords) {
+        kvs = nullptr;
+        kvs = std::make_shared<TKeyValueStorage>(TMount("tmpfs", dir, "tmpfs", {}),
+                                                 compactRecords);
+        ExpectSuccess(kvs->OpenJournal());
+    };
+
+    RemakeDir(api, dir);
+
+    Say() << "Make sure legacy nodes are moved into journal" << std::endl;
+    {
+        TScopedFd fd;
+        fd = open((dir / "legacy").ToString().c_str(), O_CREAT | O_WRONLY | O_CLOEXEC, 0600);
+        Expect(fd.GetFd() >= 0);
+        google::protobuf::io::FileOutputStream post(fd.GetFd());
+        Expect(WriteDelimitedTo(KvPair("a", "1"), &post));
+        Expect(WriteDelimitedTo(KvPair("a", "2"), &post));
+        Expect(WriteDelimitedTo(KvPair("b", "3"), &post));
+        Expect(post.Flush());
+    }
+
+    reopen(4096);
+    Expect(!(dir / "legacy").Exists());
+    ExpectEq(KvValue(kvs->GetNode(dir / "legacy"), "a"), "2");
+    ExpectEq(KvValue(kvs->GetNode(dir / "legacy"), "b"), "3");
+
+    Say() << "Make sure set, replace and remove records are replayed" << std::endl;
+    auto a = kvs->GetNode(dir / "a");
+    auto b = kvs->GetNode(dir / "b");
+    auto c = kvs->GetNode(dir / "c");
+
+    ExpectSuccess(a->Append("x", "1"));
+    ExpectSuccess(a->Append("y", "2"));
+    ExpectSuccess(a->Append("x", "3"));
+    ExpectSuccess(b->Append("x", "1"));
+    ExpectSuccess(b->Remove());
+    ExpectSuccess(c->Append("x", "1"));
+    ExpectSuccess(c->Save(KvPair("y", "2")));
+
+    ExpectEq(stat(journal.ToString().c_str(), &st), 0);
+    off_t appended = st.st_size;
+
+    reopen(4096);
+    a = kvs->GetNode(dir / "a");
+    b = kvs->GetNode(dir / "b");
+    c = kvs->GetNode(dir / "c");
+    ExpectEq(KvValue(a, "x"), "3");
+    ExpectEq(KvValue(a, "y"), "2");
+    Expect(b->Load(data));
+    ExpectEq(KvValue(c, "x"), "");
+    ExpectEq(KvValue(c, "y"), "2");
+    ExpectEq(KvValue(kvs->GetNode(dir / "legacy"), "a"), "2");
+
+    Say() << "Make sure journal is rewritten with live nodes on open" << std::endl;
+    ExpectEq(stat(journal.ToString().c_str(), &st), 0);
+    Expect(st.st_size < appended);
+
+    Say() << "Make sure truncated tail is dropped" << std::endl;
+    ExpectSuccess(a->Append("z", "tail"));
+    ExpectEq(stat(journal.ToString().c_str(), &st), 0);
+    kvs = nullptr;
+    ExpectEq(truncate(journal.ToString().c_str(), st.st_size - 2), 0);
+
+    reopen(4096);
+    a = kvs->GetNode(dir / "a");
+    ExpectEq(KvValue(a, "z"), "");
+    ExpectEq(KvValue(a, "x"), "3");
+
+    // records appended after torn tail must not be lost
+    ExpectSuccess(a->Append("z", "next"));
+    reopen(4096);
+    a = kvs->GetNode(dir / "a");
+    ExpectEq(KvValue(a, "z"), "next");
+
+    Say() << "Make sure journal is compacted after enough records" << std::endl;
+    const uint64_t compactRecords = 16;
+    reopen(compactRecords);
+    a = kvs->GetNode(dir / "a");
+
+    uint64_t compactions = Statistics->KvJournalCompactions;
+    uint64_t reclaimed = Statistics->KvReclaimedBytes;
+
+    for (uint64_t i = 0; i < compactRecords * 4; i++)
+        ExpectSuccess(a->Append("x", std::to_string(i)));
+
+    for (int i = 0; i < 100 && Statistics->KvJournalCompactions == compactions; i++)
+        usleep(10000);
+
+    Expect(Statistics->KvJournalCompactions > compactions);
+    Expect(Statistics->KvReclaimedBytes > reclaimed);
+    ExpectEq(KvValue(a, "x"), std::to_string(compactRecords * 4 - 1));
+
+    reopen(compactRecords);
+    a = kvs->GetNode(dir / "a");
+    ExpectEq(KvValue(a, "x"), std::to_string(compactRecords * 4 - 1));
+    ExpectEq(KvValue(a, "y"), "2");
+
+    kvs = nullptr;
+    ExpectSuccess(TFolder(dir).Remove(true));
+}
+
 static void TestSigPipe(TPortoAPI &api) {
     std::string before;
     ExpectApiSuccess(api.GetData("/", "porto_stat[spawned]", before));
@@ -4577,6 +4799,106 @@ static void TestWaitRecovery(TPortoAPI &api) {
     ExpectApiSuccess(api.Destroy(c));
 }
 
+static void TestKeyValueCompaction(TPortoAPI &api) {
+    std::string name = "a", v;
+    uint64_t nr = config().keyval().compact_records() + 1;
+
+    Say() << "Make sure repeated sets of one property compact journal" << std::endl;
+
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_journal_compactions]", v));
+    uint64_t compactions = std::stoull(v);
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_reclaimed_bytes]", v));
+    uint64_t reclaimed = std::stoull(v);
+
+    ExpectApiSuccess(api.Create(name));
+    for (uint64_t i = 0; i < nr; i++)
+        ExpectApiSuccess(api.SetProperty(name, "private", std::to_string(i)));
+
+    // compaction runs in background after the write which crossed the limit
+    for (int i = 0; i < 100; i++) {
+        ExpectApiSuccess(api.GetData("/", "porto_stat[kv_journal_compactions]", v));
+        if (std::stoull(v) > compactions)
+            break;
+        usleep(100000);
+    }
+    Expect(std::stoull(v) > compactions);
+
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_reclaimed_bytes]", v));
+    Expect(std::stoull(v) > reclaimed);
+
+    ExpectApiSuccess(api.GetProperty(name, "private", v));
+    ExpectEq(v, std::to_string(nr - 1));
+
+    Say() << "Make sure merged value survives restart" << std::endl;
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_journal_compactions]", v));
+    compactions = std::stoull(v);
+
+    KillSlave(api, SIGKILL);
+
+    ExpectApiSuccess(api.GetProperty(name, "private", v));
+    ExpectEq(v, std::to_string(nr - 1));
+
+    // new slave rewrites journal when opens it
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_journal_compactions]", v));
+    Expect(std::stoull(v) > compactions);
+
+    ExpectApiSuccess(api.Destroy(name));
+}
+
+static void TestUpgrade(TPortoAPI &api) {
+    std::string name = "a", v;
+    rpc::TContainerRequest req;
+    rpc::TContainerResponse rsp;
+    uint64_t reqId, id;
+
+    Say() << "Make sure idle client and OOM eventfd are handed over on update" << std::endl;
+
+    AsRoot(api);
+    RotateDaemonLogs(api);
+    AsNobody(api);
+
+    TPortoAPI idle(config().rpc_sock().file().path());
+    req.mutable_version();
+    ExpectApiSuccess(idle.PipelineSend(req, reqId));
+    ExpectApiSuccess(idle.PipelineRecv(rsp, id));
+    ExpectEq(id, reqId);
+
+    // OOM may happen while slaves change, only handed over eventfd keeps it
+    ExpectApiSuccess(api.Create(name));
+    ExpectApiSuccess(api.SetProperty(name, "command", "bash -c 'sleep 3; " + oomCommand + "'"));
+    ExpectApiSuccess(api.SetProperty(name, "memory_limit", oomMemoryLimit));
+    ExpectApiSuccess(api.Start(name));
+
+    int slavePid = ReadPid(config().slave_pid().path());
+    int masterPid = ReadPid(config().master_pid().path());
+    if (kill(masterPid, SIGHUP))
+        throw string("Can't send SIGHUP to master");
+    WaitExit(api, std::to_string(slavePid));
+    WaitPortod(api);
+
+    ExpectEq(WordCount(config().master_log().path(), "and 1 OOM eventfds from slave"), 1);
+
+    Say() << "Make sure idle client survives update" << std::endl;
+    ExpectApiSuccess(idle.PipelineSend(req, reqId));
+    ExpectApiSuccess(idle.PipelineRecv(rsp, id));
+    ExpectEq(id, reqId);
+    ExpectEq(rsp.version().tag(), GIT_TAG);
+
+    Say() << "Make sure OOM eventfd survives update" << std::endl;
+    WaitContainer(api, name);
+    ExpectApiSuccess(api.GetData(name, "exit_status", v));
+    ExpectEq(v, string("9"));
+    ExpectApiSuccess(api.GetData(name, "oom_killed", v));
+    ExpectEq(v, string("true"));
+    ExpectApiSuccess(api.Destroy(name));
+
+    // master is executed again and starts counting from scratch
+    ExpectApiSuccess(api.GetData("/", "porto_stat[spawned]", v));
+    ExpectEq(v, "1");
+
+    expectedErrors = expectedRespawns = expectedWarns = 0;
+}
+
 static void TestRecovery(TPortoAPI &api) {
     string pid, v;
     string name = "a:b";
@@ -4959,6 +5281,103 @@ static void TestVersion(TPortoAPI &api) {
     ExpectEq(revision, GIT_REVISION);
 }
 
+static void TestBatch(TPortoAPI &api) {
+    std::string name = "a";
+    std::vector<rpc::TContainerRequest> reqs(4);
+    std::vector<rpc::TContainerResponse> rsps;
+
+    Say() << "Create, configure and start container with one request" << std::endl;
+    reqs[0].mutable_create()->set_name(name);
+    reqs[1].mutable_setproperty()->set_name(name);
+    reqs[1].mutable_setproperty()->set_property("command");
+    reqs[1].mutable_setproperty()->set_value("sleep 1000");
+    reqs[2].mutable_start()->set_name(name);
+    reqs[3].mutable_getdata()->set_name(name);
+    reqs[3].mutable_getdata()->set_data("state");
+
+    ExpectApiSuccess(api.Batch(reqs, rsps));
+    ExpectEq(rsps.size(), reqs.size());
+    for (auto &r : rsps)
+        ExpectEq(r.error(), EError::Success);
+    ExpectEq(rsps[3].getdata().value(), "running");
+
+    Say() << "Make sure failed request doesn't stop batch" << std::endl;
+    ExpectApiSuccess(api.Batch(reqs, rsps));
+    ExpectEq(rsps.size(), reqs.size());
+    ExpectEq(rsps[0].error(), EError::ContainerAlreadyExists);
+    ExpectEq(rsps[3].getdata().value(), "running");
+
+    Say() << "Make sure batch stops on first error when requested" << std::endl;
+    ExpectApiSuccess(api.Batch(reqs, rsps, true));
+    ExpectEq(rsps.size(), 1);
+    ExpectEq(rsps[0].error(), EError::ContainerAlreadyExists);
+
+    Say() << "Make sure wait isn't allowed in batch" << std::endl;
+    reqs.resize(1);
+    reqs[0].mutable_wait()->add_name(name);
+    ExpectApiSuccess(api.Batch(reqs, rsps));
+    ExpectEq(rsps.size(), 1);
+    ExpectEq(rsps[0].error(), EError::InvalidMethod);
+
+    ExpectApiSuccess(api.Destroy(name));
+}
+
+static void TestPipeline(TPortoAPI &api) {
+    std::string name = "a";
+    rpc::TContainerRequest req;
+    rpc::TContainerResponse rsp;
+    uint64_t waitId, id;
+
+    ExpectApiSuccess(api.Create(name));
+    ExpectApiSuccess(api.SetProperty(name, "command", "sleep 2"));
+    ExpectApiSuccess(api.Start(name));
+
+    TPortoAPI pipe(config().rpc_sock().file().path());
+
+    Say() << "Make sure pending wait doesn't block following requests" << std::endl;
+    req.mutable_wait()->add_name(name);
+    ExpectApiSuccess(pipe.PipelineSend(req, waitId));
+
+    std::set<uint64_t> ids;
+    for (int i = 0; i < 8; i++) {
+        req.Clear();
+        req.mutable_getdata()->set_name(name);
+        req.mutable_getdata()->set_data("state");
+        ExpectApiSuccess(pipe.PipelineSend(req, id));
+        ids.insert(id);
+    }
+    ExpectEq(ids.size(), 8);
+
+    while (ids.size()) {
+        ExpectApiSuccess(pipe.PipelineRecv(rsp, id));
+        ExpectNeq(id, waitId);
+        ExpectEq(ids.count(id), 1);
+        ids.erase(id);
+        ExpectEq(rsp.error(), EError::Success);
+        ExpectEq(rsp.getdata().value(), "running");
+    }
+
+    Say() << "Make sure wait response carries its id" << std::endl;
+    ExpectApiSuccess(pipe.PipelineRecv(rsp, id));
+    ExpectEq(id, waitId);
+    ExpectEq(rsp.wait().name(), name);
+
+    Say() << "Make sure static responses carry request id" << std::endl;
+    req.Clear();
+    req.mutable_version();
+    ExpectApiSuccess(pipe.PipelineSend(req, waitId));
+    ExpectApiSuccess(pipe.PipelineRecv(rsp, id));
+    ExpectEq(id, waitId);
+    ExpectEq(rsp.version().tag(), GIT_TAG);
+
+    Say() << "Make sure requests without id are still served" << std::endl;
+    std::string v;
+    ExpectApiSuccess(pipe.GetData(name, "state", v));
+    ExpectEq(v, "dead");
+
+    ExpectApiSuccess(api.Destroy(name));
+}
+
 static void SetWorkersNr(TPortoAPI &api, size_t nr) {
     AsRoot(api);
 
@@ -5087,6 +5506,39 @@ static void TestStats(TPortoAPI &api) {
     ExpectApiSuccess(api.GetData("/", "porto_stat[warnings]", v));
     ExpectEq(v, std::to_string(warns));
 
+    std::string before;
+    ExpectApiSuccess(api.GetData("/", "porto_stat[info_requests]", before));
+    ExpectApiSuccess(api.GetData("/", "porto_stat[info_requests]", v));
+    Expect(std::stoull(v) > std::stoull(before));
+
+    // selftest never fills worker queues up to the limit
+    ExpectApiSuccess(api.GetData("/", "porto_stat[info_rejected]", v));
+    ExpectEq(v, "0");
+
+    ExpectApiSuccess(api.GetData("/", "porto_stat[knob_fds]", v));
+    Expect(std::stoull(v) <= config().daemon().max_knob_fds());
+
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_journal_writes]", before));
+    ExpectApiSuccess(api.GetData("/", "porto_stat[kv_journal_records]", v));
+    Expect(std::stoull(before) > 0);
+    Expect(std::stoull(before) <= std::stoull(v));
+
+    ExpectApiSuccess(api.GetData("/", "porto_stat[restore_load_ms]", v));
+    ExpectApiSuccess(api.GetData("/", "porto_stat[restore_containers_ms]", v));
+
+    // selftest has started plenty of containers by now
+    ExpectApiSuccess(api.GetData("/", "porto_stat[spawner_tasks]", v));
+    if (config().daemon().task_spawner())
+        Expect(std::stoull(v) > 0);
+
+    ExpectApiSuccess(api.GetData("/", "porto_clients[portotest." +
+                                 std::to_string(getpid()) + ".served]", v));
+    Expect(std::stoull(v) > 0);
+
+    AsNobody(api);
+    ExpectApiFailure(api.GetData("/", "porto_clients", v), EError::Permission);
+    AsRoot(api);
+
     if (WordCount(config().slave_log().path(),
                   "Task belongs to invalid subsystem") > 1)
         throw string("ERROR: Some task belongs to invalid subsystem!");
@@ -5164,11 +5616,16 @@ int SelfTest(std::vector<std::string> name, int leakNr) {
         { "vholder", TestVolumeHolder },
         { "volume_impl", TestVolumeImpl },
         { "sigpipe", TestSigPipe },
+        { "kvs", TestKeyValueStorage },
         { "stats", TestStats },
+        { "batch", TestBatch },
+        { "pipeline", TestPipeline },
         { "daemon", TestDaemon },
 
         // the following tests will restart porto several times
         { "bad_client", TestBadClient },
+        { "kvs_compaction", TestKeyValueCompaction },
+        { "upgrade", TestUpgrade },
         { "recovery", TestRecovery },
         { "wait_recovery", TestWaitRecovery },
         { "volume_recovery", TestVolumeRecovery },
@@ -616,7 +616,24 @@ void TestDaemon(TPortoAPI &api) {
 
     Say() << "Make sure portod-slave doesn't have zombies" << std::endl;
     pid = ReadPid(config().slave_pid().path());
-    ExpectEq(ChildrenNum(pid), 0);
+    int spawner = config().daemon().task_spawner() ? 1 : 0;
+    ExpectEq(ChildrenNum(pid), spawner);
+
+    if (spawner) {
+        vector<string> lines;
+        ExpectSuccess(Popen("pgrep -P " + std::to_string(pid), lines));
+
+        Say() << "Make sure portod-spawner doesn't have zombies" << std::endl;
+        ExpectEq(ChildrenNum(stoi(lines[0])), 0);
+
+        Say() << "Make sure portod-spawner doesn't have invalid FDs" << std::endl;
+        std::string path = "/proc/" + std::to_string(stoi(lines[0])) + "/fd";
+
+        // . .. 0(stdin) 1(stdout) 2(stderr) 3(log) spawner socket
+        int nr = scandir(path.c_str(), &lst, NULL, alphasort);
+        PrintFds(path, lst, nr);
+        Expect(nr == 2 + 5);
+    }
 
     Say() << "Make sure portod-slave doesn't have invalid FDs" << std::endl;
 
@@ -632,10 +649,17 @@ void TestDaemon(TPortoAPI &api) {
     if (config().network().dynamic_ifaces())
         nl++; // event netlink
 
-    // . .. 0(stdin) 1(stdout) 2(stderr) 3(log) 4(rpc socket) 5(epoll) 6(netlink socket) 128(event pipe) 129(ack pipe)
+    // cached cgroup knobs
+    std::string knobs;
+    ExpectApiSuccess(api.GetData("/", "porto_stat[knob_fds]", knobs));
+    nl += stoi(knobs);
+
+    // . .. 0(stdin) 1(stdout) 2(stderr) 3(log) 4(rpc socket) 5(epoll) 6(netlink socket)
+    // 7,8(key-value journals) 128(event pipe) 129(ack pipe) 130(upgrade socket)
+    // and spawner socket
     int nr = scandir(path.c_str(), &lst, NULL, alphasort);
     PrintFds(path, lst, nr);
-    Expect(nr >= 2 + 8 + nl && nr <= 2 + 8 + nl + sssFd);
+    Expect(nr >= 2 + 11 + spawner + nl && nr <= 2 + 11 + spawner + nl + sssFd);
 
     Say() << "Make sure portod-master doesn't have zombies" << std::endl;
     pid = ReadPid(config().master_pid().path());
@@ -645,10 +669,10 @@ void TestDaemon(TPortoAPI &api) {
     Say() << "Number of portod-master fds=" << nr << std::endl;
     path = ("/proc/" + std::to_string(pid) + "/fd");
 
-    // . .. 0(stdin) 1(stdout) 2(stderr) 3(log) 4(epoll) 5(event pipe) 6(ack pipe)
+    // . .. 0(stdin) 1(stdout) 2(stderr) 3(log) 4(epoll) 5(event pipe) 6(ack pipe) 7(upgrade socket)
     nr = scandir(path.c_str(), &lst, NULL, alphasort);
     PrintFds(path, lst, nr);
-    Expect(nr == 2 + 7);
+    Expect(nr == 2 + 8);
 
     Say() << "Check portod-master queue size" << std::endl;
     std::string v;
@@ -72,6 +72,7 @@ namespace test {
     int SelfTest(std::vector<std::string> name, int leakNr);
     int StressTest(int threads, int iter, bool killPorto);
     int FuzzyTest(int threads, int iter);
+    int BenchTest(std::vector<std::string> name, int nr);
 
     bool HaveCfsBandwidth();
     bool HaveCfsGroupSched();
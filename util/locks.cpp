@@ -21,6 +21,10 @@ TScopedLock TLockable::ScopedLock() {
     return TScopedLock(Mutex);
 }
 
+TScopedLock TLockable::ScopedLock(std::defer_lock_t t) {
+    return TScopedLock(Mutex, t);
+}
+
 TScopedLock TLockable::TryScopedLock() {
     return TScopedLock(Mutex, std::try_to_lock);
 }
@@ -51,6 +55,9 @@ TNestedScopedLock::TNestedScopedLock(TLockable &inner, TScopedLock &outer, std::
     }
 }
 
+// outer lock isn't held, take only inner one
+TNestedScopedLock::TNestedScopedLock(TLockable &inner) : InnerLock(inner.ScopedLock()) {}
+
 bool TNestedScopedLock::IsLocked() {
     return InnerLock.owns_lock();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mutex>
+#include <memory>
 #include "common.hpp"
 
 typedef std::unique_lock<std::mutex> TScopedLock;
@@ -16,6 +17,7 @@ private:
 class TLockable {
 public:
     TScopedLock ScopedLock();
+    TScopedLock ScopedLock(std::defer_lock_t t);
     TScopedLock TryScopedLock();
 private:
     std::mutex Mutex;
@@ -33,5 +35,28 @@ public:
     TNestedScopedLock& operator=(TNestedScopedLock &&src);
     TNestedScopedLock(TLockable &inner, TScopedLock &outer);
     TNestedScopedLock(TLockable &inner, TScopedLock &outer, std::try_to_lock_t t);
+    explicit TNestedScopedLock(TLockable &inner);
     bool IsLocked();
 };
+
+// Pointer replaced by one thread and read by others without outer lock,
+// std::atomic_load/atomic_store for shared_ptr are missing in old libstdc++
+template <typename T>
+class TAtomicSharedPtr : public TNonCopyable {
+    mutable std::mutex Mutex;
+    std::shared_ptr<T> Ptr;
+
+public:
+    TAtomicSharedPtr(std::shared_ptr<T> ptr = nullptr) : Ptr(ptr) {}
+
+    std::shared_ptr<T> Load() const {
+        std::lock_guard<std::mutex> lock(Mutex);
+        return Ptr;
+    }
+
+    // previous object is released after unlock
+    void Store(std::shared_ptr<T> ptr) {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Ptr.swap(ptr);
+    }
+};
@@ -12,6 +12,8 @@ public:
     TNamespaceFd() : Fd(-1) {}
     ~TNamespaceFd() { Close(); }
     bool IsOpened() const { return Fd >= 0; }
+    int GetFd() const { return Fd; }
+    void SetFd(int fd) { Close(); Fd = fd; }
     TError Open(TPath path);
     TError Open(pid_t pid, std::string type);
     void Close();
@@ -1095,6 +1095,15 @@ TError TNlAddr::Parse(const std::string &s) {
     return TError::Success();
 }
 
+std::string TNlAddr::Format() const {
+    char buf[128];
+
+    if (!Addr)
+        return "";
+
+    return nl_addr2str(Addr, buf, sizeof(buf));
+}
+
 TError ParseIpPrefix(const std::string &s, TNlAddr &addr, int &prefix) {
     std::vector<std::string> lines;
     TError error = SplitString(s, '/', lines);
@@ -22,6 +22,7 @@ public:
     TNlAddr &operator=(const TNlAddr &other);
     ~TNlAddr();
     TError Parse(const std::string &s);
+    std::string Format() const;
     struct nl_addr *GetAddr() const { return Addr; }
     bool IsEmpty() const;
 };
@@ -1,6 +1,8 @@
 #include <sstream>
 #include <iomanip>
 
+#include <fnmatch.h>
+
 #include "util/string.hpp"
 
 using std::string;
@@ -256,6 +258,27 @@ bool StringEndsWith(const std::string &str, const std::string &prefix) {
     return str.substr(str.length() - prefix.length(), prefix.length()) == prefix;
 }
 
+bool StringMatch(const std::string &str, const std::string &pattern) {
+    if (pattern == "***")
+        return true;
+
+    if (StringEndsWith(pattern, "***")) {
+        std::string head = pattern.substr(0, pattern.length() - 3);
+        std::string literal = StringGlobPrefix(head);
+
+        // literal head must match exactly, the rest may cross '/'
+        if (literal.length() == head.length())
+            return StringStartsWith(str, head);
+        return fnmatch((head + "*").c_str(), str.c_str(), 0) == 0;
+    }
+
+    return fnmatch(pattern.c_str(), str.c_str(), FNM_PATHNAME) == 0;
+}
+
+std::string StringGlobPrefix(const std::string &pattern) {
+    return pattern.substr(0, pattern.find_first_of("*?[\\"));
+}
+
 std::string MapToStr(const std::map<std::string, uint64_t> &m) {
     std::stringstream ss;
     for (auto pair : m) {
@@ -30,4 +30,8 @@ bool StringOnlyDigits(const std::string &s);
 std::string StringReplaceAll(const std::string &str, const std::string &from, const std::string &to);
 bool StringStartsWith(const std::string &str, const std::string &prefix);
 bool StringEndsWith(const std::string &str, const std::string &prefix);
+// fnmatch(FNM_PATHNAME) except trailing "***" which matches any suffix
+bool StringMatch(const std::string &str, const std::string &pattern);
+// Part of glob before the first special character
+std::string StringGlobPrefix(const std::string &pattern);
 std::string MapToStr(const std::map<std::string, uint64_t> &m);
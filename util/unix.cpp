@@ -25,6 +25,7 @@ extern "C" {
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/socket.h>
 }
 
 int RetryBusy(int times, int timeoMs, std::function<int()> handler) {
@@ -72,6 +73,24 @@ int SleepWhile(int timeoMs, std::function<int()> handler) {
     return RetryFailed(times, resolution, handler);
 }
 
+int RetryBackoff(int timeoMs, int maxSleepMs, std::function<int()> handler) {
+    int sleepMs = 1;
+    int ret;
+
+    while (true) {
+        ret = handler();
+        if (ret == 0 || timeoMs <= 0)
+            return ret;
+
+        sleepMs = std::min(sleepMs, timeoMs);
+        if (usleep(sleepMs * 1000) < 0)
+            return -1;
+
+        timeoMs -= sleepMs;
+        sleepMs = std::min(sleepMs * 2, maxSleepMs);
+    }
+}
+
 int GetPid() {
     return getpid();
 }
@@ -318,6 +337,95 @@ void CloseFds(int max, const std::set<int> &except, bool openStd) {
     }
 }
 
+// SCM_MAX_FD is 253
+static const size_t MAX_PASSED_FDS = 128;
+
+TError SendMessage(int sock, const std::string &data,
+                   const std::vector<int> &fds, bool block) {
+    struct iovec iov = { (void *)data.data(), data.size() };
+    struct msghdr msg = {};
+    char buf[CMSG_SPACE(MAX_PASSED_FDS * sizeof(int))];
+
+    if (fds.size() > MAX_PASSED_FDS)
+        return TError(EError::Unknown, "Too many fds to pass: " + std::to_string(fds.size()));
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    if (fds.size()) {
+        msg.msg_control = buf;
+        msg.msg_controllen = CMSG_SPACE(fds.size() * sizeof(int));
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds.data(), fds.size() * sizeof(int));
+    }
+
+    ssize_t ret;
+    do
+        ret = sendmsg(sock, &msg, (block ? 0 : MSG_DONTWAIT) | MSG_NOSIGNAL);
+    while (ret < 0 && errno == EINTR && block);
+
+    if (ret != (ssize_t)data.size())
+        return TError(EError::Unknown, errno, "sendmsg()");
+
+    return TError::Success();
+}
+
+TError RecvMessage(int sock, std::string &data, size_t maxSize,
+                   std::vector<int> &fds, bool block) {
+    std::vector<char> payload(maxSize);
+    struct iovec iov = { payload.data(), payload.size() };
+    struct msghdr msg = {};
+    char buf[CMSG_SPACE(MAX_PASSED_FDS * sizeof(int))];
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = buf;
+    msg.msg_controllen = sizeof(buf);
+
+    ssize_t ret;
+    do
+        ret = recvmsg(sock, &msg, block ? 0 : MSG_DONTWAIT);
+    while (ret < 0 && errno == EINTR && block);
+
+    if (ret < 0)
+        return TError(EError::Unknown, errno, "recvmsg()");
+    if (ret == 0)
+        return TError(EError::Unknown, "recvmsg(): connection closed");
+
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t nr = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *passed = (int *)CMSG_DATA(cmsg);
+        fds.insert(fds.end(), passed, passed + nr);
+    }
+
+    if (msg.msg_flags & MSG_CTRUNC)
+        return TError(EError::Unknown, "recvmsg(): some fds were lost");
+
+    if (msg.msg_flags & MSG_TRUNC)
+        return TError(EError::Unknown, "recvmsg(): message is longer than " +
+                      std::to_string(maxSize) + " bytes");
+
+    data.assign(payload.data(), ret);
+
+    return TError::Success();
+}
+
+TError SendFds(int sock, const std::vector<int> &fds) {
+    return SendMessage(sock, std::string(1, '\0'), fds, false);
+}
+
+TError RecvFds(int sock, std::vector<int> &fds) {
+    std::string data;
+    return RecvMessage(sock, data, 1, fds, false);
+}
+
 TError AllocLoop(const TPath &path, size_t size) {
     TError error;
     TScopedFd fd;
@@ -12,6 +12,9 @@ class TPath;
 int RetryBusy(int times, int timeoMs, std::function<int()> handler);
 int RetryFailed(int times, int timeoMs, std::function<int()> handler);
 int SleepWhile(int timeoMs, std::function<int()> handler);
+// Retries handler with sleeps 1ms, 2ms, 4ms... up to maxSleepMs in total
+// not longer than timeoMs, so short waits end almost immediately
+int RetryBackoff(int timeoMs, int maxSleepMs, std::function<int()> handler);
 int GetPid();
 int GetPPid();
 int GetTid();
@@ -30,6 +33,16 @@ TError DropBoundedCap(int cap);
 TError SetCap(uint64_t effective, uint64_t permitted, uint64_t inheritable);
 void CloseFds(int max, const std::set<int> &except, bool openStd = false);
 
+// Pass file descriptors over unix socket, one message per call, never blocks
+TError SendFds(int sock, const std::vector<int> &fds);
+TError RecvFds(int sock, std::vector<int> &fds);
+
+// Same for seqpacket socket, but with payload up to maxSize bytes
+TError SendMessage(int sock, const std::string &data,
+                   const std::vector<int> &fds, bool block);
+TError RecvMessage(int sock, std::string &data, size_t maxSize,
+                   std::vector<int> &fds, bool block);
+
 class TScopedFd : public TNonCopyable {
     int Fd;
 public:
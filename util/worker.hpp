@@ -47,6 +47,13 @@ public:
         Cv.notify_one();
     }
 
+    void Push(T &&elem) {
+        auto lock = ScopedLock();
+        Queue.push(std::move(elem));
+        Seq++;
+        Cv.notify_one();
+    }
+
     virtual void Wait(TScopedLock &lock) {
         if (!Valid)
             return;
@@ -66,8 +73,7 @@ public:
                     Wait(lock);
 
                 while (Valid && !Queue.empty()) {
-                    T request = Top();
-                    Queue.pop();
+                    T request = Pop();
 
                     size_t seq = Seq;
                     lock.unlock();
@@ -76,7 +82,7 @@ public:
                     bool haveNewData = seq != Seq;
 
                     if (!handled) {
-                        Queue.push(request);
+                        Queue.push(std::move(request));
                         if (!haveNewData)
                             Wait(lock);
                     }
@@ -107,4 +113,11 @@ public:
 
     virtual const T &Top() =0;
     virtual bool Handle(const T &elem) =0;
+
+    // override to move element out of queue instead of copying
+    virtual T Pop() {
+        T elem = Top();
+        Queue.pop();
+        return elem;
+    }
 };
@@ -1,4 +1,6 @@
 #include <sstream>
+#include <algorithm>
+#include <stdexcept>
 
 #include "value.hpp"
 #include "kv.pb.h"
@@ -7,12 +9,38 @@
 #include "util/log.hpp"
 #include "util/string.hpp"
 
+static __thread const TRawValueMap *CurrentValueMap;
+
+// Striped by slot address, held only to copy or swap one value
+static std::mutex VariantLocks[64];
+
+std::mutex &TVariant::Lock() const {
+    return VariantLocks[(uintptr_t)this / sizeof(*this) % 64];
+}
+
+TValueScope::TValueScope(const TRawValueMap *map) : Prev(CurrentValueMap) {
+    CurrentValueMap = map;
+}
+
+TValueScope::~TValueScope() {
+    CurrentValueMap = Prev;
+}
+
+const TRawValueMap *TValueScope::Current() {
+    return CurrentValueMap;
+}
+
+TVariant &TAbstractValue::Variant() const {
+    PORTO_ASSERT(CurrentValueMap != nullptr);
+    return CurrentValueMap->Slot(Index);
+}
+
 bool TAbstractValue::HasValue() const {
-    return Variant.HasValue();
+    return Variant().HasValue();
 }
 
 void TAbstractValue::Reset() {
-    Variant.Reset();
+    Variant().Reset();
 }
 
 int TAbstractValue::GetFlags() const {
@@ -196,29 +224,55 @@ TUintMap TMapValue::GetDefault() const {
     return TUintMap{};
 }
 
-TRawValueMap::~TRawValueMap() {
-    for (auto pair : AbstractValues)
-        delete pair.second;
+TValueTable::~TValueTable() {
+    for (auto av : Values)
+        delete av;
 }
 
-TError TRawValueMap::Add(const std::string &name, TAbstractValue *av) {
-    if (AbstractValues.find(name) != AbstractValues.end())
+void TValueTable::Add(const std::string &name, TAbstractValue *av) {
+    if (Index.find(name) != Index.end())
         PORTO_RUNTIME_ERROR("Duplicate value");
 
-    AbstractValues[name] = av;
-    return TError::Success();
+    av->SetIndex(Values.size());
+    Index[name] = Values.size();
+    Values.push_back(av);
+    Names.insert(std::lower_bound(Names.begin(), Names.end(), name), name);
+}
+
+int TValueTable::GetIndex(const std::string &name) const {
+    auto it = Index.find(name);
+    if (it == Index.end())
+        return -1;
+    return it->second;
+}
+
+void TRawValueMap::SetTable(const TValueTable &table, std::shared_ptr<TContainer> c) {
+    Table = &table;
+    Values.reset(new TVariant[table.Size()]);
+    Container = c;
+}
+
+std::shared_ptr<TContainer> TRawValueMap::GetContainer() const {
+    return Container.lock();
+}
+
+int TRawValueMap::GetIndex(const std::string &name) const {
+    int index = Table->GetIndex(name);
+    if (index < 0)
+        throw std::out_of_range("Unknown value " + name);
+    return index;
 }
 
 TAbstractValue *TRawValueMap::Find(const std::string &name) const {
-    return AbstractValues.at(name);
+    return Table->Get(GetIndex(name));
 }
 
 bool TRawValueMap::IsValid(const std::string &name) const {
-   return AbstractValues.find(name) != AbstractValues.end();
+    return Table->GetIndex(name) >= 0;
 }
 
 bool TRawValueMap::IsReadOnly(const std::string &name) const {
-   return Find(name)->GetFlags() & READ_ONLY_VALUE;
+    return Find(name)->GetFlags() & READ_ONLY_VALUE;
 }
 
 bool TRawValueMap::IsDefault(const std::string &name) const {
@@ -226,15 +280,11 @@ bool TRawValueMap::IsDefault(const std::string &name) const {
 }
 
 bool TRawValueMap::HasValue(const std::string &name) const {
-    TAbstractValue *p = AbstractValues.at(name);
-    return p->HasValue();
+    return Slot(GetIndex(name)).HasValue();
 }
 
 std::vector<std::string> TRawValueMap::List() const {
-    std::vector<std::string> v;
-    for (auto pair : AbstractValues)
-        v.push_back(pair.first);
-    return v;
+    return Table->List();
 }
 
 TError TValueMap::Create() {
@@ -252,6 +302,8 @@ TError TValueMap::Remove() {
 }
 
 TError TValueMap::Restore(const kv::TNode &node) {
+    TValueScope scope(this);
+
     for (int i = 0; i < node.pairs_size(); i++) {
         auto key = node.pairs(i).key();
         auto value = node.pairs(i).val();
@@ -287,6 +339,11 @@ TError TValueMap::Restore() {
     if (error)
         return error;
 
+    kv::TNode synced;
+    Dump(synced);
+    if (TKeyValueStorage::Equal(n, synced))
+        return TError::Success();
+
     error = Flush();
     if (error)
         return error;
@@ -306,47 +363,57 @@ TError TValueMap::Sync() {
         return TError::Success();
 
     kv::TNode node;
-    for (auto kv : AbstractValues) {
-        auto name = kv.first;
-        auto av = kv.second;
+    Dump(node);
+
+    if (config().log().verbose())
+        for (auto &pair : node.pairs())
+            L_ACT() << "Sync " << pair.key() << " = " << pair.val() << std::endl;
+
+    return KvNode->Append(node);
+}
+
+void TValueMap::Dump(kv::TNode &node) const {
+    TValueScope scope(this);
+
+    for (auto &name : Table->List()) {
+        auto av = Find(name);
 
         if (!(av->GetFlags() & PERSISTENT_VALUE))
             continue;
 
-        if (IsDefault(name))
+        if (!av->HasValue())
             continue;
 
         auto pair = node.add_pairs();
         pair->set_key(name);
         pair->set_val(av->ToString());
-
-        if (config().log().verbose())
-            L_ACT() << "Sync " << name << " = " << av->ToString() << std::endl;
     }
-
-    return KvNode->Append(node);
 }
 
 std::string TValueMap::ToString(const std::string &name) const {
+    TValueScope scope(this);
     return Find(name)->ToString();
 }
 
 TError TValueMap::FromString(const std::string &name, const std::string &value, bool apply) {
-    bool resetOnDefault = HasValue(name) && Find(name)->DefaultString() == value;
+    auto av = Find(name);
+    TValueScope scope(this);
+
+    bool resetOnDefault = av->HasValue() && av->DefaultString() == value;
 
-    TError error = Find(name)->FromString(value);
+    TError error = av->FromString(value);
     if (error)
         return error;
 
-    if (apply && KvNode && Find(name)->GetFlags() & PERSISTENT_VALUE)
+    if (apply && KvNode && av->GetFlags() & PERSISTENT_VALUE)
         error = KvNode->Append(name, value);
 
     if (resetOnDefault)
-        Find(name)->Reset();
+        av->Reset();
 
     return error;
 }
 
 void TValueMap::Reset(const std::string &name) {
-    Find(name)->Reset();
+    Slot(GetIndex(name)).Reset();
 }
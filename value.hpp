@@ -2,8 +2,12 @@
 
 #include <string>
 #include <map>
+#include <mutex>
 #include <memory>
 #include <set>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
 
 #include "common.hpp"
 #include "kvalue.hpp"
@@ -18,64 +22,111 @@ const unsigned int UINT_UNIT_VALUE = (1 << 29);
 // User cannot modify value
 const unsigned int READ_ONLY_VALUE = (1 << 28);
 
+class TContainer;
+
+// Unique address per type, compared instead of RTTI
+template<typename T>
+struct TTypeTag {
+    static const char Id;
+};
+
+template<typename T>
+const char TTypeTag<T>::Id = 0;
+
 class TVariant : public TNonCopyable {
     struct TValueAbstractImpl {
+        const void *Type;
+        TValueAbstractImpl(const void *type) : Type(type) {}
         virtual ~TValueAbstractImpl() {}
     };
 
     template<typename T>
     struct TValueImpl : TValueAbstractImpl {
         T Value;
-        TValueImpl(T value) : Value(value) {}
+        TValueImpl(T value) : TValueAbstractImpl(&TTypeTag<T>::Id), Value(value) {}
     };
 
     TValueAbstractImpl *Impl = nullptr;
 
+    // Children read inherited values of parent without parent's lock,
+    // so slot is accessed only under short leaf lock, see value.cpp
+    std::mutex &Lock() const;
+
+    void Replace(TValueAbstractImpl *impl) {
+        {
+            std::lock_guard<std::mutex> guard(Lock());
+            std::swap(Impl, impl);
+        }
+        delete impl;
+    }
+
 public:
     TVariant() {}
-    ~TVariant() { Reset(); }
+    ~TVariant() { delete Impl; }
 
-    bool HasValue() const { return Impl != nullptr; }
+    bool HasValue() const {
+        std::lock_guard<std::mutex> guard(Lock());
+        return Impl != nullptr;
+    }
 
+    // Copies value if it's set
     template<typename T>
-    const T Get() const {
+    bool Copy(T &value) const {
+        std::lock_guard<std::mutex> guard(Lock());
         if (!Impl)
-            PORTO_RUNTIME_ERROR("Invalid variant get: nullptr");
+            return false;
+        if (Impl->Type != &TTypeTag<T>::Id)
+            PORTO_RUNTIME_ERROR("Invalid variant cast");
+        value = static_cast<TValueImpl<T> *>(Impl)->Value;
+        return true;
+    }
 
-        try {
-            auto p = dynamic_cast<TValueImpl<T> *>(Impl);
-            if (!p)
-                PORTO_RUNTIME_ERROR(std::string("Invalid variant cast"));
-            return p->Value;
-        } catch (std::bad_cast &e) {
-            PORTO_RUNTIME_ERROR(std::string("Invalid variant cast: ") + e.what());
-            return {};
-        }
+    // Caller guarantees that value has type T
+    template<typename T>
+    bool CopyUnchecked(T &value) const {
+        std::lock_guard<std::mutex> guard(Lock());
+        if (!Impl)
+            return false;
+        value = static_cast<TValueImpl<T> *>(Impl)->Value;
+        return true;
+    }
+
+    template<typename T>
+    const T Get() const {
+        T value = T();
+        if (!Copy(value))
+            PORTO_RUNTIME_ERROR("Invalid variant get: nullptr");
+        return value;
     }
 
     template<typename T>
     void Set(const T &value) {
-        Reset();
-        Impl = new TValueImpl<T>(value);
+        Replace(new TValueImpl<T>(value));
     };
 
     void Reset() {
-        if (Impl) {
-            delete Impl;
-            Impl = nullptr;
-        }
+        Replace(nullptr);
     }
 };
 
 template<typename T>
 class TValue;
 
+class TRawValueMap;
+
+// Descriptor of a value, shared by all maps built from the same table.
+// Value itself lives in the map which is currently accessed, see TValueScope.
 class TAbstractValue : public TNonCopyable {
+    const void *Type;
+    int Index = -1;
+
 protected:
-    TVariant Variant;
     int Flags;
+
+    TVariant &Variant() const;
+
 public:
-    TAbstractValue(int flags) : Flags(flags) {}
+    TAbstractValue(int flags, const void *type) : Type(type), Flags(flags) {}
     virtual ~TAbstractValue() {}
 
     virtual std::string ToString() const =0;
@@ -85,38 +136,33 @@ public:
     bool HasValue() const;
     void Reset();
     int GetFlags() const;
+    int GetIndex() const { return Index; }
+    void SetIndex(int index) { Index = index; }
+
+    template<typename T>
+    bool IsType() const {
+        return Type == &TTypeTag<T>::Id;
+    }
 
     template<typename T>
     const T Get() const {
-        try {
-            auto p = dynamic_cast<const TValue<T> *>(this);
-            if (!p)
-                PORTO_RUNTIME_ERROR(std::string("Bad cast"));
-            return p->Get();
-        } catch (std::bad_cast &e) {
-            PORTO_RUNTIME_ERROR(std::string("Bad cast: ") + e.what());
-            return {};
-        }
+        if (!IsType<T>())
+            PORTO_RUNTIME_ERROR(std::string("Bad cast"));
+        return static_cast<const TValue<T> *>(this)->Get();
     }
 
     template<typename T>
     TError Set(const T& value) {
-        try {
-            auto p = dynamic_cast<TValue<T> *>(this);
-            if (!p)
-                PORTO_RUNTIME_ERROR(std::string("Bad cast"));
-            return p->Set(value);
-        } catch (std::bad_cast &e) {
-            PORTO_RUNTIME_ERROR(std::string("Bad cast: ") + e.what());
-            return TError(EError::Unknown, "");
-        }
+        if (!IsType<T>())
+            PORTO_RUNTIME_ERROR(std::string("Bad cast"));
+        return static_cast<TValue<T> *>(this)->Set(value);
     }
 };
 
 template<typename T>
 class TValue : public TAbstractValue {
 public:
-    TValue(int flags) : TAbstractValue(flags) {}
+    TValue(int flags) : TAbstractValue(flags, &TTypeTag<T>::Id) {}
 
     virtual T GetDefault() const =0;
     virtual std::string ToString(const T &value) const =0;
@@ -133,10 +179,10 @@ public:
     }
 
     const T Get() const {
-        if (Variant.HasValue())
-            return Variant.Get<T>();
-        else
-            return GetDefault();
+        T value = T();
+        if (Variant().Copy(value))
+            return value;
+        return GetDefault();
     }
 
     TError Set(const T &value) {
@@ -144,7 +190,7 @@ public:
         if (error)
             return error;
 
-        Variant.Set(value);
+        Variant().Set(value);
 
         return TError::Success();
     }
@@ -208,14 +254,57 @@ public:
     TUintMap GetDefault() const override;
 };
 
+// Typed key of a value: slot in the table and type are known at compile time,
+// see TValueTable::Add(key, value) which checks them against the descriptor
+template<typename T>
+struct TValueKey {
+    typedef T Type;
+    int Index;
+    const char *Name;
+};
+
+// Descriptors of values indexed by name, built once for each kind of map
+class TValueTable : public TNonCopyable {
+    std::vector<TAbstractValue *> Values;
+    std::unordered_map<std::string, int> Index;
+    std::vector<std::string> Names;
+
+public:
+    ~TValueTable();
+
+    void Add(const std::string &name, TAbstractValue *av);
+
+    template<typename T, typename V>
+    void Add(const TValueKey<T> &key, V *av) {
+        static_assert(std::is_base_of<TValue<T>, V>::value,
+                      "Value type doesn't match its key");
+        PORTO_ASSERT(key.Index == (int)Values.size());
+        Add(key.Name, av);
+    }
+    int GetIndex(const std::string &name) const;
+    TAbstractValue *Get(int index) const { return Values[index]; }
+    size_t Size() const { return Values.size(); }
+    const std::vector<std::string> &List() const { return Names; }
+};
+
 class TRawValueMap {
+    friend class TAbstractValue;
+    friend class TValueScope;
+
 protected:
-    std::map<std::string, TAbstractValue *> AbstractValues;
+    const TValueTable *Table = nullptr;
+    std::unique_ptr<TVariant[]> Values;
+    std::weak_ptr<TContainer> Container;
+
+    TVariant &Slot(int index) const { return Values[index]; }
 
 public:
-    virtual ~TRawValueMap();
+    virtual ~TRawValueMap() {}
+
+    void SetTable(const TValueTable &table, std::shared_ptr<TContainer> c = nullptr);
+    std::shared_ptr<TContainer> GetContainer() const;
 
-    TError Add(const std::string &name, TAbstractValue *av);
+    int GetIndex(const std::string &name) const;
     TAbstractValue *Find(const std::string &name) const;
     bool IsValid(const std::string &name) const;
     bool IsDefault(const std::string &name) const;
@@ -224,6 +313,16 @@ public:
     std::vector<std::string> List() const;
 };
 
+// Makes values of the map current for descriptor methods in this thread
+class TValueScope : public TNonCopyable {
+    const TRawValueMap *Prev;
+public:
+    TValueScope(const TRawValueMap *map);
+    ~TValueScope();
+
+    static const TRawValueMap *Current();
+};
+
 class TValueMap : public TRawValueMap, public TNonCopyable {
     std::shared_ptr<TKeyValueNode> KvNode;
 
@@ -236,58 +335,81 @@ public:
     TError Restore();
     TError Flush();
     TError Sync();
+    void Dump(kv::TNode &node) const;
 
     std::string ToString(const std::string &name) const;
     TError FromString(const std::string &name, const std::string &value, bool apply = true);
 
+    template<typename T>
+    const T GetAt(int index) const {
+        T value = T();
+        if (Slot(index).Copy(value))
+            return value;
+
+        TValueScope scope(this);
+        return Table->Get(index)->Get<T>();
+    }
+
     template<typename T>
     const T Get(const std::string &name) const {
-        return Find(name)->Get<T>();
+        return GetAt<T>(GetIndex(name));
+    }
+
+    template<typename T>
+    const T Get(const TValueKey<T> &key) const {
+        T value = T();
+        if (Slot(key.Index).CopyUnchecked(value))
+            return value;
+
+        TValueScope scope(this);
+        return static_cast<const TValue<T> *>(Table->Get(key.Index))->GetDefault();
     }
 
     template<typename T>
     bool IsDefaultValue(const std::string &name, const T& value) {
-        try {
-            auto av = Find(name);
-            auto p = dynamic_cast<TValue<T> *>(av);
-            if (!p)
-                PORTO_RUNTIME_ERROR(std::string("Bad cast"));
-            return p->GetDefault() == value;
-        } catch (std::bad_cast &e) {
-            PORTO_RUNTIME_ERROR(std::string("Bad cast: ") + e.what());
-        }
-        return false;
+        auto av = Find(name);
+        if (!av->IsType<T>())
+            PORTO_RUNTIME_ERROR(std::string("Bad cast"));
+        TValueScope scope(this);
+        return static_cast<TValue<T> *>(av)->GetDefault() == value;
     }
 
     template<typename T>
     const TError GetChecked(const std::string &name, T &val) const {
-        try {
-            auto av = Find(name);
-            if (dynamic_cast<TValue<T> *>(av)) {
-                val = av->Get<T>();
-                return TError::Success();
-            }
-        } catch (...) {
-        }
-        return TError(EError::InvalidValue, "Invalid value type");
+        if (!IsValid(name) || !Find(name)->IsType<T>())
+            return TError(EError::InvalidValue, "Invalid value type");
+        val = Get<T>(name);
+        return TError::Success();
     }
 
     template<typename T>
     TError Set(const std::string &name, const T& value) {
-        bool resetOnDefault = IsDefaultValue(name, value);
-        TError error = Find(name)->Set<T>(value);
+        auto av = Find(name);
+        if (!av->IsType<T>())
+            PORTO_RUNTIME_ERROR(std::string("Bad cast"));
+        return Set(TValueKey<T>{ av->GetIndex(), name.c_str() }, value);
+    }
+
+    template<typename T>
+    TError Set(const TValueKey<T> &key, const typename TValueKey<T>::Type &value) {
+        auto av = static_cast<TValue<T> *>(Table->Get(key.Index));
+        TValueScope scope(this);
+
+        bool resetOnDefault = av->GetDefault() == value;
+
+        TError error = av->Set(value);
         if (error)
             return error;
 
-        if (KvNode && Find(name)->GetFlags() & PERSISTENT_VALUE)
-            error = KvNode->Append(name, Find(name)->ToString());
+        if (KvNode && av->GetFlags() & PERSISTENT_VALUE)
+            error = KvNode->Append(key.Name, av->ToString());
 
         // we don't want to keep default values in memory but we also
         // want custom TValue descendants to do some internal preparation
         // even if we set value to default; so just set it and reset
         // afterwards
         if (resetOnDefault)
-            Find(name)->Reset();
+            av->Reset();
 
         return error;
     }
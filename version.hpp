@@ -0,0 +1,2 @@
+const std::string GIT_REVISION = "85836eea4791a04d3b0cdd984901198abdd22fb8";
+const std::string GIT_TAG = "";
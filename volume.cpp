@@ -658,9 +658,8 @@ bool TVolume::IsAutoStorage() const {
 }
 
 TPath TVolume::GetStorage() const {
-    auto val = Config->Find(V_STORAGE);
-    if (val->HasValue())
-        return val->Get<std::string>();
+    if (Config->HasValue(V_STORAGE))
+        return Config->Get<std::string>(V_STORAGE);
     else
         return GetInternal(GetBackend());
 }
@@ -1111,8 +1110,8 @@ std::map<std::string, std::string> TVolume::GetProperties(TPath container_root)
 
     for (auto name: Config->List()) {
         auto property = Config->Find(name);
-        if (!(property->GetFlags() & HIDDEN_VALUE) && property->HasValue())
-            ret[name] = property->ToString();
+        if (!(property->GetFlags() & HIDDEN_VALUE) && Config->HasValue(name))
+            ret[name] = Config->ToString(name);
     }
 
     if (Config->HasValue(V_LAYERS)) {
@@ -1193,32 +1192,41 @@ const std::vector<std::pair<std::string, std::string>> TVolumeHolder::ListProper
     };
 }
 
-static void RegisterVolumeProperties(std::shared_ptr<TRawValueMap> m) {
-    m->Add(V_PATH, new TStringValue(HIDDEN_VALUE | PERSISTENT_VALUE));
-    m->Add(V_AUTO_PATH, new TBoolValue(HIDDEN_VALUE | PERSISTENT_VALUE));
-    m->Add(V_STORAGE, new TStringValue(PERSISTENT_VALUE));
+static TValueTable *NewVolumeTable() {
+    auto table = new TValueTable;
+
+    table->Add(V_PATH, new TStringValue(HIDDEN_VALUE | PERSISTENT_VALUE));
+    table->Add(V_AUTO_PATH, new TBoolValue(HIDDEN_VALUE | PERSISTENT_VALUE));
+    table->Add(V_STORAGE, new TStringValue(PERSISTENT_VALUE));
+
+    table->Add(V_BACKEND, new TStringValue(PERSISTENT_VALUE));
 
-    m->Add(V_BACKEND, new TStringValue(PERSISTENT_VALUE));
+    table->Add(V_USER, new TStringValue(PERSISTENT_VALUE));
+    table->Add(V_GROUP, new TStringValue(PERSISTENT_VALUE));
+    table->Add(V_PERMISSIONS, new TStringValue(PERSISTENT_VALUE));
+    table->Add(V_CREATOR, new TStringValue(READ_ONLY_VALUE | PERSISTENT_VALUE));
 
-    m->Add(V_USER, new TStringValue(PERSISTENT_VALUE));
-    m->Add(V_GROUP, new TStringValue(PERSISTENT_VALUE));
-    m->Add(V_PERMISSIONS, new TStringValue(PERSISTENT_VALUE));
-    m->Add(V_CREATOR, new TStringValue(READ_ONLY_VALUE | PERSISTENT_VALUE));
+    table->Add(V_ID, new TIntValue(HIDDEN_VALUE | PERSISTENT_VALUE));
+    table->Add(V_READY, new TBoolValue(READ_ONLY_VALUE | PERSISTENT_VALUE));
+    table->Add(V_PRIVATE, new TStringValue(PERSISTENT_VALUE));
+    table->Add(V_CONTAINERS, new TListValue(HIDDEN_VALUE | PERSISTENT_VALUE));
 
-    m->Add(V_ID, new TIntValue(HIDDEN_VALUE | PERSISTENT_VALUE));
-    m->Add(V_READY, new TBoolValue(READ_ONLY_VALUE | PERSISTENT_VALUE));
-    m->Add(V_PRIVATE, new TStringValue(PERSISTENT_VALUE));
-    m->Add(V_CONTAINERS, new TListValue(HIDDEN_VALUE | PERSISTENT_VALUE));
+    table->Add(V_LOOP_DEV, new TIntValue(HIDDEN_VALUE | PERSISTENT_VALUE));
+    table->Add(V_READ_ONLY, new TBoolValue(PERSISTENT_VALUE));
+    table->Add(V_LAYERS, new TListValue(HIDDEN_VALUE | PERSISTENT_VALUE));
 
-    m->Add(V_LOOP_DEV, new TIntValue(HIDDEN_VALUE | PERSISTENT_VALUE));
-    m->Add(V_READ_ONLY, new TBoolValue(PERSISTENT_VALUE));
-    m->Add(V_LAYERS, new TListValue(HIDDEN_VALUE | PERSISTENT_VALUE));
+    table->Add(V_SPACE_LIMIT, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
+    table->Add(V_INODE_LIMIT, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
 
-    m->Add(V_SPACE_LIMIT, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
-    m->Add(V_INODE_LIMIT, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
+    table->Add(V_SPACE_GUARANTEE, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
+    table->Add(V_INODE_GUARANTEE, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
 
-    m->Add(V_SPACE_GUARANTEE, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
-    m->Add(V_INODE_GUARANTEE, new TUintValue(PERSISTENT_VALUE | UINT_UNIT_VALUE));
+    return table;
+}
+
+static void RegisterVolumeProperties(std::shared_ptr<TRawValueMap> m) {
+    static const TValueTable *table = NewVolumeTable();
+    m->SetTable(*table);
 }
 
 TError TVolumeHolder::Create(std::shared_ptr<TVolume> &volume) {